@@ -0,0 +1,40 @@
+﻿# include "AreaSelectIndex.hpp"
+
+void AreaSelectIndex::clear()
+{
+	m_anchors.clear();
+	m_groupBounds.clear();
+	counts = {};
+	groupArenaVersion = 0;
+}
+
+void AreaSelectIndex::addAnchor(const Vec2& pos, SelectType type, int32 id, const Optional<int32>& topGroupId)
+{
+	m_anchors.push_back(Anchor{ pos, type, id, topGroupId.value_or(-1) });
+}
+
+void AreaSelectIndex::expandGroup(int32 groupId, const Vec2& pos)
+{
+	auto [it, inserted] = m_groupBounds.try_emplace(groupId, Bounds{ pos, pos });
+	if (not inserted) {
+		auto& b = it->second;
+		b.min = Vec2{ Min(b.min.x, pos.x), Min(b.min.y, pos.y) };
+		b.max = Vec2{ Max(b.max.x, pos.x), Max(b.max.y, pos.y) };
+	}
+}
+
+void AreaSelectIndex::build()
+{
+	std::sort(m_anchors.begin(), m_anchors.end(), [](const Anchor& a, const Anchor& b) { return a.pos.x < b.pos.x; });
+}
+
+bool AreaSelectIndex::containsGroup(const RectF& area, int32 groupId) const
+{
+	auto it = m_groupBounds.find(groupId);
+	if (it == m_groupBounds.end()) {
+		// メンバーの無いグループ（候補には上がらない）
+		return true;
+	}
+	// 矩形は凸なので、外接矩形の左上と右下が入っていれば中の点はすべて入る
+	return area.contains(it->second.min) && area.contains(it->second.max);
+}
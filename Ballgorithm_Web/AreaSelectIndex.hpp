@@ -0,0 +1,67 @@
+﻿#pragma once
+
+# include <Siv3D.hpp>
+# include "Domain.hpp"
+
+// 範囲選択（selectObjectsInArea）用の索引
+// 選択の判定に使う位置（エッジの端点・スタート円の中心・ゴールの中心・ボールの中心）を x の昇順に並べ、
+// 矩形に入るものを二分探索で引く。グループはメンバー全体の外接矩形を持ち、中身を展開せずに判定する
+class AreaSelectIndex {
+public:
+	struct Anchor {
+		Vec2 pos;
+		SelectType type;
+		int32 id;
+		int32 topGroupId;  // 属するトップレベルグループ（無ければ -1）
+	};
+
+	void clear();
+
+	// ロックされていないオブジェクトの位置を登録する（build() まで検索には使えない）
+	void addAnchor(const Vec2& pos, SelectType type, int32 id, const Optional<int32>& topGroupId);
+
+	// グループのメンバー（入れ子を含む）の位置を外接矩形に加える
+	void expandGroup(int32 groupId, const Vec2& pos);
+
+	void build();
+
+	// area に入るアンカーを x の昇順に f へ渡す
+	template <class F>
+	void forEachIn(const RectF& area, F&& f) const
+	{
+		auto it = std::lower_bound(m_anchors.begin(), m_anchors.end(), area.x,
+			[](const Anchor& a, double x) { return a.pos.x < x; });
+		for (; it != m_anchors.end() && it->pos.x <= area.x + area.w; ++it) {
+			if (area.intersects(it->pos)) {
+				f(*it);
+			}
+		}
+	}
+
+	// グループのメンバーがすべて area に入っているか（外接矩形の2隅で判定する）
+	bool containsGroup(const RectF& area, int32 groupId) const;
+
+	// 登録したときのステージの要素数（無効化漏れの検出用。DEBUG ビルドでだけ照合する）
+	struct Counts {
+		int32 edges = 0;
+		int32 startCircles = 0;
+		int32 goalAreas = 0;
+		int32 placedBalls = 0;
+		int32 groups = 0;
+
+		bool operator==(const Counts&) const = default;
+	};
+	Counts counts;
+
+	// グループの外接矩形を作ったときの GroupArena::version（グループの構成が変わったら作り直す）
+	uint64 groupArenaVersion = 0;
+
+private:
+	struct Bounds {
+		Vec2 min;
+		Vec2 max;
+	};
+
+	Array<Anchor> m_anchors;
+	HashTable<int32, Bounds> m_groupBounds;
+};
@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 # include <Siv3D.hpp>
+# include <span>
 # include "HashCache.hpp"
 #include <Siv3D/AsyncHTTPTask.hpp>
 #include <Siv3D/String.hpp>
@@ -90,6 +91,8 @@ struct PlacedBall {
 		archive(center, kind, isLocked);
 	}
 
+	bool operator==(const PlacedBall&) const = default;
+
 	bool isSmall() const { return kind == BallKind::Small; }
 	bool isLarge() const { return kind == BallKind::Large; }
 };
@@ -120,6 +123,7 @@ inline void Formatter(FormatData& formatData, const HoverType& value)
 struct HoverInfo {
 	HoverType type;
 	int32 id; // 点・線・StartCircle・GoalArea・PlacedBall のインデックス
+	uint32 generation = 0;  // 点・線・PlacedBall のときはスロットの世代（スロットが使い回されたら古いホバーと分かる）
 	bool operator==(const HoverInfo& other) const = default;
 	friend void Formatter(FormatData& formatData, const HoverInfo& value)
 	{
@@ -226,6 +230,7 @@ struct Group {
 	}
 
 	void insert(const Group& group) { m_groups.push_back(group); }
+	void insert(Group&& group) { m_groups.push_back(std::move(group)); }
 	void insertPointId(int32 pointId) { m_pointIds.insert(pointId); }
 	void insertGoalAreaId(int32 goalAreaId) { m_goalAreaIds.insert(goalAreaId); }
 	void insertStartCircleId(int32 startCircleId) { m_startCircleIds.insert(startCircleId); }
@@ -347,6 +352,175 @@ struct Group {
 	}
 };
 
+// グループの中身を入れ子まで含めて平らにしたもの（GroupArena の区間を指すだけで、コピーしない）
+struct GroupMembers {
+	std::span<const int32> pointIds;
+	std::span<const int32> placedBallIds;
+	std::span<const int32> startCircleIds;
+	std::span<const int32> goalAreaIds;
+};
+
+// グループの木を1本の配列に並べ直した表（m_groups から作る）
+// ノードを行きがけ順に並べるので、どのノードでも部分木のメンバーは種類ごとの配列の連続した区間になる
+// 部分木を平らにするのは区間を返すだけで、HashSet を作ったり再帰したりしない
+// メンバー → トップレベルグループ の逆引きも同じ区間から作って一緒に持つ（グループから派生させるのはこの表だけ）
+// 解除では子のノードをトップレベルに付け替えるだけ、グループ化では外したノードを残したまま新しい木を末尾に足す
+// （使われなくなったノードが半分を超えたら Stage::groupArena() で作り直す）
+struct GroupArena {
+	enum MemberKind { Points, PlacedBalls, StartCircles, GoalAreas, MemberKindCount };
+
+	struct Node {
+		int32 firstChild = -1;   // 直下の子（Group::m_groups の順に nextSibling でつながる）
+		int32 nextSibling = -1;
+		int32 subtreeEnd = 0;    // 部分木の最後のノードの次
+		std::array<int32, MemberKindCount> memberBegin{};  // 部分木のメンバーの区間
+		std::array<int32, MemberKindCount> memberEnd{};
+	};
+
+	Array<Node> nodes;
+	std::array<Array<int32>, MemberKindCount> members;
+	HashTable<int32, int32> rootOfGroup;  // トップレベルのグループID → ノード
+	std::array<HashTable<int32, int32>, MemberKindCount> topGroupOf;  // メンバー → それを含むトップレベルグループID（入れ子の中身も直接対応させる）
+	uint64 version = 0;  // 書き換えるたびに進む（clear() でも戻さない。範囲選択の索引がどの状態から作られたかを見分ける）
+	int32 groupCount = 0;  // 登録したトップレベルグループの数（m_groups.size() と一致しなければ無効化漏れ。DEBUG ビルドで照合する）
+	int32 unusedNodeCount = 0;  // 外して使われなくなったノードの数
+
+	void clear()
+	{
+		nodes.clear();
+		for (auto& m : members) m.clear();
+		rootOfGroup.clear();
+		for (auto& t : topGroupOf) t.clear();
+		groupCount = 0;
+		unusedNodeCount = 0;
+		++version;
+	}
+
+	void add(int32 topGroupId, const Group& group)
+	{
+		const int32 root = addNode(group);
+		rootOfGroup[topGroupId] = root;
+		assignTopGroup(root, topGroupId);
+		++groupCount;
+		++version;
+	}
+
+	// トップレベルのグループを外す（別のグループに取り込まれるとき。部分木のノードは残して使わなくなる）
+	void remove(int32 topGroupId)
+	{
+		auto it = rootOfGroup.find(topGroupId);
+		if (it == rootOfGroup.end()) {
+			return;
+		}
+		unusedNodeCount += nodes[it->second].subtreeEnd - it->second;
+		assignTopGroup(it->second, none);
+		rootOfGroup.erase(it);
+		--groupCount;
+		++version;
+	}
+
+	// グループを解除し、直下の子の部分木をそのままトップレベルに付け替える
+	// childGroupIds[k] は Group::m_groups[k] に振った新しいグループID
+	void ungroup(int32 topGroupId, const Array<int32>& childGroupIds)
+	{
+		auto it = rootOfGroup.find(topGroupId);
+		if (it == rootOfGroup.end()) {
+			return;
+		}
+		int32 child = nodes[it->second].firstChild;
+		assignTopGroup(it->second, none);  // 根の直下のメンバーはどのグループにも属さなくなる
+		rootOfGroup.erase(it);
+		--groupCount;
+		++unusedNodeCount;  // 使われなくなるのは根のノードだけ
+		for (int32 childGroupId : childGroupIds) {
+			if (child == -1) {
+				break;
+			}
+			rootOfGroup[childGroupId] = child;
+			assignTopGroup(child, childGroupId);
+			++groupCount;
+			child = nodes[child].nextSibling;
+		}
+		++version;
+	}
+
+	// 使われなくなったノードが半分を超えたか
+	bool needsCompaction() const { return static_cast<int32>(nodes.size()) < unusedNodeCount * 2; }
+
+	// 登録されていないグループは空
+	GroupMembers membersOf(int32 topGroupId) const
+	{
+		auto it = rootOfGroup.find(topGroupId);
+		if (it == rootOfGroup.end()) {
+			return {};
+		}
+		const Node& node = nodes[it->second];
+		auto span = [&](MemberKind kind) {
+			return std::span<const int32>{ members[kind].data() + node.memberBegin[kind], static_cast<size_t>(node.memberEnd[kind] - node.memberBegin[kind]) };
+		};
+		return { span(Points), span(PlacedBalls), span(StartCircles), span(GoalAreas) };
+	}
+
+	// id を含むトップレベルグループ
+	Optional<int32> findTopGroup(MemberKind kind, int32 id) const
+	{
+		if (auto it = topGroupOf[kind].find(id); it != topGroupOf[kind].end()) {
+			return it->second;
+		}
+		return none;
+	}
+
+private:
+	// 部分木のメンバーの逆引きを topGroupId にする（none なら外す）
+	void assignTopGroup(int32 node, const Optional<int32>& topGroupId)
+	{
+		const Node& n = nodes[node];
+		for (int32 k = 0; k < MemberKindCount; ++k) {
+			for (int32 i = n.memberBegin[k]; i < n.memberEnd[k]; ++i) {
+				if (topGroupId) {
+					topGroupOf[k][members[k][i]] = *topGroupId;
+				}
+				else {
+					topGroupOf[k].erase(members[k][i]);
+				}
+			}
+		}
+	}
+
+	int32 addNode(const Group& group)
+	{
+		const int32 index = static_cast<int32>(nodes.size());
+		nodes.push_back(Node{});
+		for (int32 k = 0; k < MemberKindCount; ++k) {
+			nodes[index].memberBegin[k] = static_cast<int32>(members[k].size());
+		}
+
+		// 自分の直下のメンバーを先に置き、続けて子の部分木を置く
+		members[Points].insert(members[Points].end(), group.m_pointIds.begin(), group.m_pointIds.end());
+		members[PlacedBalls].insert(members[PlacedBalls].end(), group.m_placedBallIds.begin(), group.m_placedBallIds.end());
+		members[StartCircles].insert(members[StartCircles].end(), group.m_startCircleIds.begin(), group.m_startCircleIds.end());
+		members[GoalAreas].insert(members[GoalAreas].end(), group.m_goalAreaIds.begin(), group.m_goalAreaIds.end());
+
+		int32 prevChild = -1;
+		for (const auto& g : group.m_groups) {
+			const int32 child = addNode(g);
+			if (prevChild == -1) {
+				nodes[index].firstChild = child;
+			}
+			else {
+				nodes[prevChild].nextSibling = child;
+			}
+			prevChild = child;
+		}
+
+		nodes[index].subtreeEnd = static_cast<int32>(nodes.size());
+		for (int32 k = 0; k < MemberKindCount; ++k) {
+			nodes[index].memberEnd[k] = static_cast<int32>(members[k].size());
+		}
+		return index;
+	}
+};
+
 struct StartCircle { Circle circle; bool isLocked = false; };
 struct GoalArea { RectF rect; bool isLocked = false; };
 
@@ -369,16 +543,112 @@ struct Edge {
 	}
 };
 
+// 点ID → その点を端点に持つエッジのインデックス
+// 選択された点からつながるエッジを、全エッジを走査せずに引くための索引
+struct IncidentEdgeIndex {
+	Array<Array<int32>> edgesOfPoint;
+	int32 edgeCount = 0;  // 登録したエッジの数（m_edges.size() と一致しなければ無効化漏れ。DEBUG ビルドで照合する）
+
+	void clear()
+	{
+		edgesOfPoint.clear();
+		edgeCount = 0;
+	}
+
+	void add(int32 edgeIndex, const Edge& edge)
+	{
+		for (auto pid : edge.ids) {
+			if (edgesOfPoint.size() <= pid) {
+				edgesOfPoint.resize(pid + 1);
+			}
+			edgesOfPoint[pid].push_back(edgeIndex);
+		}
+		++edgeCount;
+	}
+
+	const Array<int32>& of(int32 pointId) const
+	{
+		static const Array<int32> empty;
+		return (0 <= pointId && pointId < edgesOfPoint.size()) ? edgesOfPoint[pointId] : empty;
+	}
+};
+
+// 向きを区別しない線分（両端を座標の小さい順に並べて持つ）
+struct EdgeSegment {
+	Vec2 a;
+	Vec2 b;
+
+	EdgeSegment(const Vec2& p, const Vec2& q)
+	{
+		// -0.0 と 0.0 で別のハッシュにならないよう 0.0 を足してそろえる
+		const Vec2 p0{ p.x + 0.0, p.y + 0.0 };
+		const Vec2 q0{ q.x + 0.0, q.y + 0.0 };
+		const bool pFirst = (p0.x < q0.x) || (p0.x == q0.x && p0.y <= q0.y);
+		a = pFirst ? p0 : q0;
+		b = pFirst ? q0 : p0;
+	}
+
+	bool operator==(const EdgeSegment&) const = default;
+};
+
+namespace std {
+	template<>
+	struct hash<EdgeSegment>
+	{
+		size_t operator()(const EdgeSegment& v) const noexcept
+		{
+			return hash_values(v.a, v.b);
+		}
+	};
+}
+
+// ステージ上の線分の集合（同じ線分が複数あれば数で持つ）
+// 貼り付け位置の重なり判定を、クリップボードのエッジごとに1回のハッシュ引きで済ませる
+struct EdgeSegmentSet {
+	HashTable<EdgeSegment, int32> counts;
+	int32 edgeCount = 0;  // 登録したエッジの数（m_edges.size() と一致しなければ無効化漏れ。DEBUG ビルドで照合する）
+
+	void clear()
+	{
+		counts.clear();
+		edgeCount = 0;
+	}
+
+	void add(const EdgeSegment& segment)
+	{
+		++counts[segment];
+		++edgeCount;
+	}
+
+	bool contains(const EdgeSegment& segment) const { return counts.contains(segment); }
+};
+
+// 選択を種類ごとのビット列に展開したもの
+// 描画や当たり判定で1要素ずつ「選択されているか」を引くときに、選択グループを毎回辿らずに済ませる
+struct SelectionMask {
+	Array<bool> points;        // 点ID → 直接選択されているか、選択グループに含まれるか
+	Array<bool> edges;         // エッジのインデックス
+	Array<bool> startCircles;
+	Array<bool> goalAreas;
+	Array<bool> placedBalls;
+	bool hasGroup = false;     // グループが1つでも選択されているか
+	int32 pointCount = 0;      // 直接選択されている点の数
+
+	static bool Test(const Array<bool>& bits, int32 index) { return 0 <= index && index < bits.size() && bits[index]; }
+};
+
 // 選択されたIDのセットを管理する構造体
 struct SelectedIDSet {
 	HashSet<SelectedID> m_ids;
+	uint64 m_version = 0;  // 選択が変わるたびに増やす（m_ids を直接書き換えたら touch() を呼ぶこと）
 	
 	// HashSet<SelectedID> の基本操作をラップ
-	void clear() { m_ids.clear(); }
+	void clear() { m_ids.clear(); touch(); }
 	bool empty() const { return m_ids.empty(); }
 	int32 size() const { return m_ids.size(); }
-	void insert(const SelectedID& id) { m_ids.insert(id); }
-	void erase(const SelectedID& id) { m_ids.erase(id); }
+	void insert(const SelectedID& id) { m_ids.insert(id); touch(); }
+	void erase(const SelectedID& id) { m_ids.erase(id); touch(); }
+	void touch() { ++m_version; }
 	bool contains(const SelectedID& id) const { return m_ids.contains(id); }
 	auto begin() const { return m_ids.begin(); }
 	auto end() const { return m_ids.end(); }
@@ -391,6 +661,9 @@ struct SelectedIDSet {
 	bool isSelectedGoalArea(int32 index) const;
 	bool isSelectedGoalArea(const Stage& stage, int32 index) const;
 	bool isSelectedPlacedBall(const Stage& stage, int32 index) const;
+
+	// 選択を展開したマスク（選択かステージの構成が変わったときだけ作り直す）
+	const SelectionMask& mask(const Stage& stage) const;
 	
 	// 選択オブジェクトの操作
 	Optional<Vec2> getBeginPointOfSelectedObjects(const Stage& stage) const;
@@ -409,4 +682,25 @@ struct SelectedIDSet {
 	{
 		formatData.string += Format(value.m_ids);
 	}
+
+private:
+	// mask() のキャッシュと、それを作ったときの選択・ステージの状態
+	struct MaskKey {
+		const Stage* stage = nullptr;
+		uint64 version = 0;
+		int32 selectedCount = 0;
+		int32 pointSlotCount = 0;
+		int32 edgeCount = 0;        // エッジ・配置ボールは ID の範囲（スロット数）
+		uint64 pointsVersion = 0;   // 表の version()（スロットが使い回されても数は変わらないので）
+		uint64 edgesVersion = 0;
+		uint64 placedBallsVersion = 0;
+		int32 groupCount = 0;
+		int32 startCircleCount = 0;
+		int32 goalAreaCount = 0;
+		int32 placedBallCount = 0;
+
+		bool operator==(const MaskKey&) const = default;
+	};
+	mutable SelectionMask m_mask;
+	mutable Optional<MaskKey> m_maskKey;
 };
@@ -0,0 +1,117 @@
+﻿# include "DragSession.hpp"
+# include "Stage.hpp"
+
+void DragSession::begin(const SelectedIDSet& selected, const Stage& stage)
+{
+	m_stage = &stage;
+	m_selectionVersion = selected.m_version;
+	m_selectedCount = selected.size();
+	m_pointsVersion = stage.m_points.version();
+	m_edgesVersion = stage.m_edges.version();
+	m_placedBallsVersion = stage.m_placedBalls.version();
+
+	// 選択グループの中身も含めて展開したマスクから、動かすオブジェクトを拾う
+	const SelectionMask& mask = selected.mask(stage);
+	auto collect = [](const Array<bool>& bits, Array<int32>& out) {
+		out.clear();
+		for (int32 i = 0; i < bits.size(); ++i) {
+			if (bits[i]) out.push_back(i);
+		}
+	};
+	collect(mask.points, m_pointIds);
+	collect(mask.startCircles, m_startCircleIds);
+	collect(mask.goalAreas, m_goalAreaIds);
+	collect(mask.placedBalls, m_placedBallIds);
+
+	// 動く点につながるエッジ（両端とも動くものは e[0] 側から1回だけ拾う）
+	m_edgeIndices.clear();
+	m_edgeEndMoved.clear();
+	m_stretchedEdgeIndices.clear();
+	for (int32 pid : m_pointIds) {
+		for (int32 edgeIndex : stage.incidentEdges(pid)) {
+			const auto& e = stage.m_edges[edgeIndex];
+			if (e.isLocked) continue;
+
+			const bool end0Moved = SelectionMask::Test(mask.points, e[0]);
+			const bool end1Moved = SelectionMask::Test(mask.points, e[1]);
+			if (end0Moved && end1Moved && pid != e[0]) continue;
+
+			m_edgeIndices.push_back(edgeIndex);
+			m_edgeEndMoved.emplace_back(end0Moved ? 1.0 : 0.0, end1Moved ? 1.0 : 0.0);
+			if (end0Moved != end1Moved) {
+				m_stretchedEdgeIndices.push_back(edgeIndex);
+			}
+		}
+	}
+	m_lines.reserve(m_edgeIndices.size());
+}
+
+bool DragSession::isActiveFor(const SelectedIDSet& selected, const Stage& stage) const
+{
+	return m_stage == &stage
+		&& m_selectionVersion == selected.m_version
+		&& m_selectedCount == selected.size()
+		&& m_pointsVersion == stage.m_points.version()
+		&& m_edgesVersion == stage.m_edges.version()
+		&& m_placedBallsVersion == stage.m_placedBalls.version();
+}
+
+bool DragSession::canMove(const Stage& stage, const Vec2& delta) const
+{
+	// No restriction
+	if (stage.nonEditableAreas().empty()) {
+		return true;
+	}
+
+	for (int32 pid : m_pointIds) {
+		if (stage.isPointInNonEditableArea(stage.m_points.at(pid) + delta)) return false;
+	}
+
+	m_lines.clear();
+	for (int32 i = 0; i < m_edgeIndices.size(); ++i) {
+		const auto& e = stage.m_edges[m_edgeIndices[i]];
+		const auto [moved0, moved1] = m_edgeEndMoved[i];
+		m_lines.emplace_back(stage.m_points.at(e[0]) + delta * moved0, stage.m_points.at(e[1]) + delta * moved1);
+	}
+	if (not stage.areLinesAllowedInEditableArea(m_lines)) {
+		return false;
+	}
+
+	for (int32 id : m_startCircleIds) {
+		if (stage.isPointInNonEditableArea(stage.m_startCircles[id].circle.center + delta)) return false;
+	}
+	for (int32 id : m_goalAreaIds) {
+		if (stage.isPointInNonEditableArea(stage.m_goalAreas[id].rect.pos + delta)) return false;
+	}
+	for (int32 id : m_placedBallIds) {
+		if (stage.isPointInNonEditableArea(stage.m_placedBalls[id].center + delta)) return false;
+	}
+	return true;
+}
+
+void DragSession::move(Stage& stage, const Vec2& delta) const
+{
+	const int64 lengthBefore = stretchedEdgeLengthUnits(stage);
+	stage.m_points.translate(m_pointIds, delta);
+	stage.addToScoreLength(stretchedEdgeLengthUnits(stage) - lengthBefore);
+	for (int32 id : m_startCircleIds) {
+		stage.m_startCircles[id].circle.center += delta;
+	}
+	for (int32 id : m_goalAreaIds) {
+		stage.m_goalAreas[id].rect.pos += delta;
+	}
+	for (int32 id : m_placedBallIds) {
+		stage.m_placedBalls[id].center += delta;
+	}
+	stage.invalidateSpatialCaches();
+}
+
+int64 DragSession::stretchedEdgeLengthUnits(const Stage& stage) const
+{
+	int64 sum = 0;
+	for (int32 edgeIndex : m_stretchedEdgeIndices) {
+		const auto& e = stage.m_edges[edgeIndex];
+		sum += ScoreCounters::LengthUnits(stage.m_points.at(e[0]), stage.m_points.at(e[1]));
+	}
+	return sum;
+}
@@ -0,0 +1,52 @@
+﻿#pragma once
+
+# include <Siv3D.hpp>
+# include "Domain.hpp"
+
+class Stage;
+
+// 選択オブジェクトをドラッグで動かしている間のキャッシュ
+// ドラッグ開始時に選択を1回だけ展開しておき、毎フレームの判定と移動は添字の配列を辿るだけにする
+class DragSession {
+public:
+	// selected を展開してセッションを始める
+	void begin(const SelectedIDSet& selected, const Stage& stage);
+
+	void end() { m_stage = nullptr; }
+
+	// selected と stage が begin したときのままか（選択や構成が変わったら作り直す）
+	bool isActiveFor(const SelectedIDSet& selected, const Stage& stage) const;
+
+	// delta だけ動かしても編集不可エリアに掛からないか（SelectedIDSet::isMovedSelectedNotInNonEditableArea と同じ判定）
+	bool canMove(const Stage& stage, const Vec2& delta) const;
+
+	// 展開済みのオブジェクトを delta だけ動かす（スコアの合計長も差分で更新する）
+	void move(Stage& stage, const Vec2& delta) const;
+
+private:
+	// begin したときの選択・ステージの状態
+	const Stage* m_stage = nullptr;
+	uint64 m_selectionVersion = 0;
+	int32 m_selectedCount = 0;
+	// 表の version()（追加・削除・Undo で進むので、持っている ID のスロットが使い回されていないと分かる）
+	uint64 m_pointsVersion = 0;
+	uint64 m_edgesVersion = 0;
+	uint64 m_placedBallsVersion = 0;
+
+	// 動かすオブジェクト（重複なし）
+	Array<int32> m_pointIds;
+	Array<int32> m_startCircleIds;
+	Array<int32> m_goalAreaIds;
+	Array<int32> m_placedBallIds;
+
+	// 動く点につながるロックされていないエッジと、各端が動くなら 1.0 / 動かないなら 0.0
+	Array<int32> m_edgeIndices;
+	Array<std::pair<double, double>> m_edgeEndMoved;
+	// そのうち片端だけが動くエッジ（移動で長さが変わるのはこれだけ）
+	Array<int32> m_stretchedEdgeIndices;
+
+	mutable Array<Line> m_lines;  // canMove の作業用
+
+	// ScoreCounters::LengthUnits の合計
+	int64 stretchedEdgeLengthUnits(const Stage& stage) const;
+};
@@ -8,6 +8,13 @@ inline P2Body createLine(P2World& world, P2BodyType bodyType, const Line& line,
 	return world.createLine(bodyType, worldPos, line.movedBy(-worldPos), oneSided, material, filter);
 }
 
+// 複数の線分を1つの剛体にまとめる（両面の場合は線分ごとのフィクスチャになる）
+inline P2Body createLineString(P2World& world, P2BodyType bodyType, const LineString& lineString, OneSided oneSided = OneSided::No, const P2Material& material = {}, const P2Filter& filter = {})
+{
+	Vec2 worldPos = lineString.front();
+	return world.createLineString(bodyType, worldPos, lineString.movedBy(-worldPos), oneSided, material, filter);
+}
+
 inline P2Body createCircle(P2World& world, P2BodyType bodyType, const Circle& circle, const P2Material& material = {}, const P2Filter& filter = {})
 {
 	Vec2 worldPos = circle.center;
@@ -0,0 +1,77 @@
+﻿# include "GoalAreaIndex.hpp"
+
+GoalAreaIndex::GoalAreaIndex(const Array<GoalArea>& goalAreas)
+	: m_occupancy(goalAreas.size())
+{
+	for (const auto& g : goalAreas) {
+		m_rects.push_back(g.rect);
+	}
+
+	for (int32 i = 0; i < m_rects.size(); ++i) {
+		const Point tl = CellOf(m_rects[i].tl());
+		const Point br = CellOf(m_rects[i].br());
+		for (int32 y = tl.y; y <= br.y; ++y) {
+			for (int32 x = tl.x; x <= br.x; ++x) {
+				m_cells[Point{ x, y }].push_back(i);
+			}
+		}
+	}
+}
+
+bool GoalAreaIndex::updateBall(Ball& ball)
+{
+	if (ball.body.isEmpty()) {
+		removeBall(ball);
+		return false;
+	}
+
+	const Vec2 pos = ball.body.getPos();
+	m_found.clear();
+	if (auto it = m_cells.find(CellOf(pos)); it != m_cells.end()) {
+		for (int32 i : it->second) {
+			if (m_rects[i].contains(pos)) {
+				m_found.push_back(i);
+			}
+		}
+	}
+
+	if (ball.isRegisteredInGoals && ball.goalIndices == m_found) {
+		return false;
+	}
+
+	addToOccupancy(ball.goalIndices, ball.kind, -1);
+	addToOccupancy(m_found, ball.kind, +1);
+	ball.goalIndices = m_found;
+	ball.isRegisteredInGoals = true;
+	return true;
+}
+
+void GoalAreaIndex::removeBall(Ball& ball)
+{
+	addToOccupancy(ball.goalIndices, ball.kind, -1);
+	ball.goalIndices.clear();
+	ball.isRegisteredInGoals = false;
+}
+
+const GoalAreaIndex::Occupancy& GoalAreaIndex::occupancy(int32 goalIndex) const
+{
+	static const Occupancy empty;
+	if (goalIndex < 0 || m_occupancy.size() <= goalIndex) {
+		return empty;
+	}
+	return m_occupancy[goalIndex];
+}
+
+Point GoalAreaIndex::CellOf(const Vec2& pos)
+{
+	return Point{ static_cast<int32>(Math::Floor(pos.x / CellSize)), static_cast<int32>(Math::Floor(pos.y / CellSize)) };
+}
+
+void GoalAreaIndex::addToOccupancy(const Array<int32>& goalIndices, BallKind kind, int32 delta)
+{
+	for (int32 i : goalIndices) {
+		auto& occupancy = m_occupancy[i];
+		occupancy.counts[kind] += delta;
+		occupancy.total += delta;
+	}
+}
@@ -0,0 +1,45 @@
+﻿#pragma once
+
+# include <Siv3D.hpp>
+# include "Domain.hpp"
+# include "Query.hpp"
+
+// ゴールエリアの空間インデックスと、ゴールごとの在室ボール数
+// startSimulation で1回だけ構築し、以降はボールの出入りを差分で反映する
+// 判定側は在室数を読むだけで済み、毎ステップ ボール数 × ゴール数 の走査をしない
+class GoalAreaIndex {
+public:
+	// ゴールに入っているボールの数
+	struct Occupancy {
+		HashTable<BallKind, int32> counts;
+		int32 total = 0;
+
+		int32 countOf(BallKind kind) const {
+			auto it = counts.find(kind);
+			return (it != counts.end()) ? it->second : 0;
+		}
+	};
+
+	GoalAreaIndex() = default;
+	explicit GoalAreaIndex(const Array<GoalArea>& goalAreas);
+
+	// ボールの所属ゴールを現在位置で更新し、在室数に反映する。所属が変わったら true
+	bool updateBall(Ball& ball);
+
+	// 取り除くボールを在室数から外す
+	void removeBall(Ball& ball);
+
+	// ゴールごとの在室数（範囲外のインデックスは空）
+	const Occupancy& occupancy(int32 goalIndex) const;
+
+private:
+	static constexpr double CellSize = 128.0;
+
+	Array<RectF> m_rects;
+	HashTable<Point, Array<int32>> m_cells;  // セル → そのセルに掛かるゴール（昇順）
+	Array<Occupancy> m_occupancy;
+	Array<int32> m_found;  // updateBall の作業用
+
+	static Point CellOf(const Vec2& pos);
+	void addToOccupancy(const Array<int32>& goalIndices, BallKind kind, int32 delta);
+};
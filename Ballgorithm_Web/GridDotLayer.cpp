@@ -0,0 +1,68 @@
+﻿# include "GridDotLayer.hpp"
+
+namespace
+{
+	// 画面上の点の間隔（ピクセル）に応じた濃さ。間隔が詰まるほど薄くして、遠景で面が埋まらないようにする
+	double FadeBySpacing(double spacingPx)
+	{
+		return Clamp((spacingPx - 6.0) / 10.0, 0.0, 1.0);
+	}
+}
+
+void GridDotLayer::draw(const RectF& region, int32 oneGridLength, double scale) const
+{
+	const int32 zoomBand = static_cast<int32>(Math::Round(Math::Log2(scale) * ZoomBandsPerOctave));
+	if (oneGridLength != m_gridLength || m_zoomBand != zoomBand) {
+		rebuild(oneGridLength, zoomBand);
+	}
+	if (not m_tile) {
+		return;
+	}
+
+	// タイルの左上は偶数番目の格子点から半マス戻した位置（点がタイルの境目に掛からないように）
+	const double tileLength = oneGridLength * 2.0;
+	const double half = oneGridLength * 0.5;
+	const double x0 = Math::Floor((region.x + half) / tileLength) * tileLength - half;
+	const double y0 = Math::Floor((region.y + half) / tileLength) * tileLength - half;
+	const int32 countX = static_cast<int32>(Math::Ceil((region.x + region.w - x0) / tileLength));
+	const int32 countY = static_cast<int32>(Math::Ceil((region.y + region.h - y0) / tileLength));
+
+	const ScopedRenderStates2D sampler{ SamplerState::RepeatLinear };
+	m_tile.mapped(m_tile.width() * countX, m_tile.height() * countY)
+		.resized(tileLength * countX, tileLength * countY)
+		.draw(x0, y0);
+}
+
+void GridDotLayer::rebuild(int32 oneGridLength, int32 zoomBand) const
+{
+	m_gridLength = oneGridLength;
+	m_zoomBand = zoomBand;
+
+	// 段階の代表の拡大率で、1マスを何テクセルにするか決める（テクセル ≒ 画面のピクセル）
+	const double bandScale = Math::Exp2(zoomBand / ZoomBandsPerOctave);
+	const double spacingPx = oneGridLength * bandScale;
+	const int32 cellTexels = Clamp(static_cast<int32>(Math::Round(spacingPx / 2.0)) * 2, 2, 256);
+	const int32 tileTexels = cellTexels * 2;
+
+	// 偶数番目の格子点（タイルの左上の点）は濃く、それ以外は薄く。間隔が詰まったら薄い点から消える
+	const Color strong{ 255, 255, 255, static_cast<uint8>(255 * 0.25 * FadeBySpacing(spacingPx * 2.0)) };
+	const Color weak{ 255, 255, 255, static_cast<uint8>(255 * 0.15 * FadeBySpacing(spacingPx)) };
+
+	Image image{ static_cast<size_t>(tileTexels), static_cast<size_t>(tileTexels), Color{ 255, 255, 255, 0 } };
+	auto putDot = [&](int32 cx, int32 cy, const Color& color) {
+		// 画面上で約 2px の点（格子点を中心に 2×2 テクセル）
+		for (int32 y = cy - 1; y < cy + 1; ++y) {
+			for (int32 x = cx - 1; x < cx + 1; ++x) {
+				image[y][x] = color;
+			}
+		}
+	};
+	const int32 c0 = cellTexels / 2;
+	const int32 c1 = c0 + cellTexels;
+	putDot(c0, c0, strong);
+	putDot(c1, c0, weak);
+	putDot(c0, c1, weak);
+	putDot(c1, c1, weak);
+
+	m_tile = Texture{ image };
+}
@@ -0,0 +1,21 @@
+﻿#pragma once
+
+# include <Siv3D.hpp>
+
+// 編集画面の背景のグリッド点
+// 2×2 マスぶんの点を描いたタイル画像を作っておき、繰り返しサンプリングで見えている範囲に1回の描画で敷き詰める
+// タイルはグリッド間隔かズームの段階が変わったときだけ作り直す（点の大きさと遠景での薄め方は段階ごとに焼き込む）
+class GridDotLayer {
+public:
+	// region: 見えている範囲（ワールド座標）, oneGridLength: 点の間隔, scale: ワールド → 画面の拡大率
+	void draw(const RectF& region, int32 oneGridLength, double scale) const;
+
+private:
+	static constexpr double ZoomBandsPerOctave = 4.0;  // ズームを何段階で区切るか（2倍ごとに）
+
+	mutable Texture m_tile;
+	mutable int32 m_gridLength = 0;
+	mutable Optional<int32> m_zoomBand;
+
+	void rebuild(int32 oneGridLength, int32 zoomBand) const;
+};
@@ -0,0 +1,104 @@
+﻿# include "HeadlessVerify.hpp"
+# include "Game.hpp"
+# include "SimulationEngine.hpp"
+
+namespace {
+	constexpr StringView VerifyOption = U"--verify";
+	constexpr StringView ParallelOption = U"--parallel";
+	constexpr StringView ReuseWorldOption = U"--reuse-world";  // パス中の壁の剛体を次のクエリで使い回す（ゲーム本体とは判定が変わり得る）
+	constexpr StringView MergeLinesOption = U"--merge-lines";  // 連なる壁を1つの剛体にまとめる
+
+	struct VerifyOptions {
+		bool parallel = false;
+		bool reuseWorld = false;
+		bool mergeLines = false;
+	};
+
+	void VerifyStage(Stage& stage, const VerifyOptions& options)
+	{
+		Console << U"== {} ({} edges) =="_fmt(stage.m_name, stage.m_edges.size());
+
+		stage.m_reuseStaticBodies = options.reuseWorld;
+		stage.m_mergeConnectedLines = options.mergeLines;
+		const bool parallel = options.parallel;
+
+		const Stopwatch stopwatch{ StartImmediately::Yes };
+		const auto results = parallel
+			? SimulationEngine::VerifyAllQueriesAsync(stage).get()
+			: SimulationEngine{ stage }.runAllQueries();
+		const double elapsedMs = stopwatch.msF();
+
+		int64 totalSteps = 0;
+		for (const auto& result : results) {
+			totalSteps += result.steps;
+			Console << U"  Query {}: {} ({} steps){}"_fmt(
+				result.queryIndex + 1,
+				(result.isSuccess ? U"pass" : U"fail"),
+				result.steps,
+				(result.isTimedOut ? U" [timeout]" : U""));
+		}
+
+		Console << U"  {} / {} passed, {} steps, {:.1f} ms ({:.3f} ms/step)"_fmt(
+			results.count_if([](const auto& r) { return r.isSuccess; }),
+			results.size(),
+			totalSteps,
+			elapsedMs,
+			(totalSteps > 0 ? elapsedMs / totalSteps : 0.0));
+
+		// 壁の剛体数（まとめた場合の削減量の確認用）
+		// 並列検証は複製で走り、使い回さなければクエリごとに破棄されるので、逐次で使い回したときだけ表示する
+		if (not parallel and options.reuseWorld) {
+			Console << U"  static bodies: {} (lines: {})"_fmt(stage.m_linesInWorld.size(), stage.m_initialLines.size());
+		}
+
+		// ゲーム本体ではクエリごとに新しいワールドで走らせるので、使い回した壁はここで捨てる
+		stage.m_reuseStaticBodies = false;
+		stage.m_mergeConnectedLines = false;
+		stage.m_linesInWorld.clear();
+		stage.m_world = P2World{};
+		stage.m_hasStaticBodies = false;
+	}
+}
+
+bool IsHeadlessVerifyRequested(const Array<String>& args)
+{
+	return args.includes(String{ VerifyOption });
+}
+
+void RunHeadlessVerify(Game& game, const Array<String>& args)
+{
+	VerifyOptions options;
+	options.parallel = args.includes(String{ ParallelOption });
+	options.reuseWorld = args.includes(String{ ReuseWorldOption });
+	options.mergeLines = args.includes(String{ MergeLinesOption });
+	Array<String> positional = args.removed(String{ ParallelOption }).removed(String{ ReuseWorldOption }).removed(String{ MergeLinesOption });
+
+	if (options.reuseWorld) {
+		Console << U"warning: --reuse-world keeps wall bodies between queries; contact order may diverge from the game, so verdicts may differ";
+	}
+	const size_t optionIndex = std::distance(positional.begin(), std::find(positional.begin(), positional.end(), VerifyOption));
+	const String stageName = (optionIndex + 1 < positional.size()) ? positional[optionIndex + 1] : U"all";
+	const FilePath savePath = (optionIndex + 2 < positional.size()) ? positional[optionIndex + 2] : FilePath{};
+
+	if (stageName == U"all") {
+		for (const auto& stage : game.m_stages) {
+			VerifyStage(*stage, options);
+		}
+		return;
+	}
+
+	if (not game.m_stageNameToIndex.contains(stageName)) {
+		Console << U"Unknown stage: {}"_fmt(stageName);
+		return;
+	}
+
+	auto& stage = *game.m_stages[game.m_stageNameToIndex[stageName]];
+	if (not savePath.isEmpty()) {
+		if (not FileSystem::Exists(savePath)) {
+			Console << U"Save file not found: {}"_fmt(savePath);
+			return;
+		}
+		stage.load(savePath);
+	}
+	VerifyStage(stage, options);
+}
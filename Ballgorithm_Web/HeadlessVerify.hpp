@@ -0,0 +1,16 @@
+﻿#pragma once
+
+# include <Siv3D.hpp>
+
+class Game;
+
+// コマンドラインからの一括検証（描画なし）
+// 使い方: Ballgorithm_Web --verify <ステージ名 | all> [セーブファイル(.bin)] [--parallel] [--reuse-world] [--merge-lines]
+// --parallel を付けるとクエリごとに独立したワールドで並列に検証する
+// 既定ではゲーム本体と同じくクエリごとに新しいワールドで走らせる
+// --reuse-world を付けるとパス中の壁の剛体を次のクエリで使い回す（所要時間の比較用。接触の順序が変わり得るので判定はゲームと一致するとは限らない）
+// --merge-lines を付けると連なる壁を1つの剛体にまとめ、剛体数と1ステップあたりの時間を比較できる
+// セーブファイル省略時は各ステージの保存済み解答（Ballgorithm/V2Stages）を使う
+// 各クエリの成否とステップ数、所要時間を Console に出力する
+bool IsHeadlessVerifyRequested(const Array<String>& args);
+void RunHeadlessVerify(Game& game, const Array<String>& args);
@@ -16,6 +16,8 @@ struct InventorySlot
 	Optional<int32> maxCount;   // none = infinite
 	int32 usedCount = 0;
 
+	bool operator==(const InventorySlot&) const = default;
+
 	template<class Archive>
 	void SIV3D_SERIALIZE(Archive& archive)
 	{
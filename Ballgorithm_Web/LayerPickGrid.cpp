@@ -0,0 +1,62 @@
+﻿# include "LayerPickGrid.hpp"
+
+void LayerPickGrid::clear()
+{
+	m_cells.clear();
+	m_count = 0;
+}
+
+void LayerPickGrid::insert(int32 layerPos, const RectF& rect)
+{
+	const int32 x0 = CellOf(rect.x), x1 = CellOf(rect.rightX());
+	const int32 y0 = CellOf(rect.y), y1 = CellOf(rect.bottomY());
+	for (int32 y = y0; y <= y1; ++y) {
+		for (int32 x = x0; x <= x1; ++x) {
+			m_cells[Point{ x, y }].push_back(layerPos);
+		}
+	}
+	++m_count;
+}
+
+void LayerPickGrid::insertLine(int32 layerPos, const Line& line)
+{
+	const Vec2 a = (line.begin.x <= line.end.x) ? line.begin : line.end;
+	const Vec2 b = (line.begin.x <= line.end.x) ? line.end : line.begin;
+	const double dx = b.x - a.x;
+
+	// 列ごとに、線分がその列で取る y の範囲のセルを登録する
+	const int32 x0 = CellOf(a.x), x1 = CellOf(b.x);
+	for (int32 x = x0; x <= x1; ++x) {
+		double ya = a.y, yb = b.y;
+		if (dx > 0.0) {
+			const double left = Max(a.x, x * CellSize);
+			const double right = Min(b.x, (x + 1) * CellSize);
+			ya = a.y + (b.y - a.y) * (left - a.x) / dx;
+			yb = a.y + (b.y - a.y) * (right - a.x) / dx;
+		}
+		const int32 y0 = CellOf(Min(ya, yb)), y1 = CellOf(Max(ya, yb));
+		for (int32 y = y0; y <= y1; ++y) {
+			m_cells[Point{ x, y }].push_back(layerPos);
+		}
+	}
+	++m_count;
+}
+
+Array<int32> LayerPickGrid::query(const Vec2& pos, double margin) const
+{
+	Array<int32> result;
+	const int32 x0 = CellOf(pos.x - margin), x1 = CellOf(pos.x + margin);
+	const int32 y0 = CellOf(pos.y - margin), y1 = CellOf(pos.y + margin);
+	for (int32 y = y0; y <= y1; ++y) {
+		for (int32 x = x0; x <= x1; ++x) {
+			if (auto it = m_cells.find(Point{ x, y }); it != m_cells.end()) {
+				result.append(it->second);
+			}
+		}
+	}
+
+	// 複数セルに跨るオブジェクトの重複を除き、手前から並べる
+	std::sort(result.begin(), result.end(), std::greater<int32>());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+	return result;
+}
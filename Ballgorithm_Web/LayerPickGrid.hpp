@@ -0,0 +1,30 @@
+﻿#pragma once
+
+# include <Siv3D.hpp>
+
+// レイヤー上のオブジェクトを一様グリッドに登録し、カーソル付近の候補だけを引くための索引
+// 値は m_layerOrder 上の位置なので、レイヤー順序が変わったら作り直す
+class LayerPickGrid {
+public:
+	void clear();
+
+	// 登録済みの数（m_layerOrder.size() と一致しなければ無効化漏れ。DEBUG ビルドで照合する）
+	int32 size() const { return m_count; }
+
+	// 矩形（円は外接矩形）で登録
+	void insert(int32 layerPos, const RectF& rect);
+
+	// 線分が通るセルにだけ登録（長い斜めの線でも外接矩形全体には広げない）
+	void insertLine(int32 layerPos, const Line& line);
+
+	// pos から margin 以内に掛かるセルの候補を、手前（layerPos が大きい）順に返す
+	Array<int32> query(const Vec2& pos, double margin) const;
+
+private:
+	static constexpr double CellSize = 64.0;
+
+	HashTable<Point, Array<int32>> m_cells;
+	int32 m_count = 0;
+
+	static int32 CellOf(double v) { return static_cast<int32>(Math::Floor(v / CellSize)); }
+};
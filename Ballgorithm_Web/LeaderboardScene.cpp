@@ -1,6 +1,7 @@
 ﻿# include "LeaderboardScene.hpp"
 # include "Game.hpp"
 # include "Stage.hpp"
+# include "SimulationEngine.hpp"
 
 namespace {
 	constexpr std::array<double, 4> kSimulationSpeeds = { 1.0, 2.0, 4.0, 8.0 };
@@ -62,6 +63,7 @@ void LeaderboardScene::layoutViewerUI()
 	m_simulationStopButtonRect = RectF{ x, btnY, 80, btnH };
 	x += 80 + gap;
 	m_simulationFastForwardButtonRect = RectF{ x, btnY, 55, btnH };
+	m_replayButtonRect = RectF{ rightX + 10, 65, 100, 36 };
 
 	const double panelMargin = 10;
 	const double panelW = 220;
@@ -75,6 +77,9 @@ void LeaderboardScene::layoutViewerUI()
 	const double loadH = 40;
 	const double loadY = m_queryPanelRect.y + m_queryPanelRect.h + 8;
 	m_loadButtonRect = RectF{ m_queryPanelRect.x, loadY, loadW, loadH };
+
+	// replay seek bar: replaces the replay button while playing, up to the query panel
+	m_viewerPlayer.setRect(RectF{ m_replayButtonRect.x, m_replayButtonRect.y, Max(0.0, m_queryPanelRect.x - m_replayButtonRect.x - 10), m_replayButtonRect.h });
 }
 
 void LeaderboardScene::enterViewer(Game& game, int32 recordIndex)
@@ -90,6 +95,7 @@ void LeaderboardScene::enterViewer(Game& game, int32 recordIndex)
 
 	m_selectedRecordIndex = recordIndex;
 	m_viewerActive = true;
+	m_viewerPlayer.stop();
 
 	// スナップショットを一時ステージに適用（元のステージのクエリを使う）
 	m_viewerStage.restoreRecord(m_records[recordIndex]);
@@ -402,6 +408,7 @@ void LeaderboardScene::updateViewer(Game& game, double dt)
 		if (MouseL.down() && !stage.m_isSimulationRunning) {
 			stage.m_currentQueryIndex = 0;
 			m_singleQueryMode = false;
+			m_viewerPlayer.stop();
 			stage.startSimulation();
 		}
 		Cursor::RequestStyle(CursorStyle::Hand);
@@ -417,8 +424,11 @@ void LeaderboardScene::updateViewer(Game& game, double dt)
 
 	// Stop ボタン
 	if (m_cursorPos.intersects_use(m_simulationStopButtonRect)) {
-		if (MouseL.down() && stage.m_isSimulationRunning) {
-			stage.endSimulation();
+		if (MouseL.down()) {
+			if (stage.m_isSimulationRunning) {
+				stage.endSimulation();
+			}
+			m_viewerPlayer.stop();
 		}
 		Cursor::RequestStyle(CursorStyle::Hand);
 	}
@@ -432,6 +442,25 @@ void LeaderboardScene::updateViewer(Game& game, double dt)
 		Cursor::RequestStyle(CursorStyle::Hand);
 	}
 
+	// 記録した軌跡を再生（物理演算なし）
+	if (!stage.m_isSimulationRunning && !m_viewerPlayer.isActive() && stage.hasTrajectoryRecording()
+		&& m_cursorPos.intersects_use(m_replayButtonRect)) {
+		if (MouseL.down()) {
+			m_viewerPlayer.start(stage);
+		}
+		Cursor::RequestStyle(CursorStyle::Hand);
+	}
+
+	// クエリパネルから実行が始まったらリプレイは終える
+	if (m_viewerPlayer.isActive()) {
+		if (stage.m_isSimulationRunning) {
+			m_viewerPlayer.stop();
+		}
+		else {
+			m_viewerPlayer.update(stage, m_cursorPos, dt, kSimulationSpeeds[m_speedIndex]);
+		}
+	}
+
 	//// Load ボタン
 	//if (m_cursorPos.intersects_use(m_loadButtonRect)) {
 	//	if (MouseL.down() && !stage.m_isSimulationRunning) {
@@ -447,52 +476,29 @@ void LeaderboardScene::updateViewer(Game& game, double dt)
 	//}
 
 	// シミュレーション更新
-	if (stage.m_isSimulationRunning && !stage.m_isSimulationPaused) {
-		double fallThreshold = stage.getLowestY() + 100;
-		for (auto& c : stage.m_startBallsInWorld) {
-			if (c.body.getPos().y > fallThreshold) {
-				c.body.release();
-			}
-		}
-		stage.m_startBallsInWorld.remove_if([](const auto& c) { return c.body.isEmpty(); });
-
-		bool allFinished = true;
-		for (const auto& c : stage.m_startBallsInWorld) {
-			if (c.body.isEmpty()) continue;
-			const bool finishedBySleep = !c.body.isAwake();
-			const bool finishedByGoal = (c.timeSinceEnteredGoal && (*c.timeSinceEnteredGoal >= 1.0));
-			allFinished &= (finishedBySleep || finishedByGoal);
-		}
+	if (const auto verdict = SimulationEngine{ stage }.pollVerdict()) {
+		bool isSuccess = *verdict;
+		int32 completedQueryIndex = stage.m_currentQueryIndex;
 
-		bool hasFinishedReleasing = true;
-		if (stage.m_currentQueryIndex < stage.m_queries->size()) {
-			hasFinishedReleasing = (*stage.m_queries)[stage.m_currentQueryIndex]->hasFinishedReleasing();
+		if (isSuccess) {
+			stage.markQueryCompleted(completedQueryIndex);
+		}
+		else {
+			stage.markQueryFailed(completedQueryIndex);
 		}
 
-		if (allFinished && hasFinishedReleasing) {
-			bool isSuccess = stage.checkSimulationResult();
-			int32 completedQueryIndex = stage.m_currentQueryIndex;
-
-			if (isSuccess) {
-				stage.markQueryCompleted(completedQueryIndex);
-			}
-			else {
-				stage.markQueryFailed(completedQueryIndex);
-			}
-
-			stage.endSimulation();
+		stage.endSimulation();
 
-			if (m_singleQueryMode) {
-				m_singleQueryMode = false;
+		if (m_singleQueryMode) {
+			m_singleQueryMode = false;
+		}
+		else {
+			if (completedQueryIndex + 1 < stage.m_queries->size()) {
+				stage.m_currentQueryIndex = completedQueryIndex + 1;
+				stage.startSimulation();
 			}
 			else {
-				if (completedQueryIndex + 1 < stage.m_queries->size()) {
-					stage.m_currentQueryIndex = completedQueryIndex + 1;
-					stage.startSimulation();
-				}
-				else {
-					stage.m_currentQueryIndex = 0;
-				}
+				stage.m_currentQueryIndex = 0;
 			}
 		}
 	}
@@ -511,54 +517,7 @@ void LeaderboardScene::updateViewer(Game& game, double dt)
 	m_viewerCamera.update(dt);
 
 	// 物理シミュレーションステップ
-	if (stage.m_isSimulationRunning && !stage.m_isSimulationPaused) {
-		auto cameraTf = m_viewerCamera.createTransformer();
-		for (stage.m_simulationTimeAccumlate += dt * stage.m_simulationSpeed;
-			stage.m_simulationTimeAccumlate >= Stage::simulationTimeStep;
-			stage.m_simulationTimeAccumlate -= Stage::simulationTimeStep)
-		{
-			stage.m_world.update(Stage::simulationTimeStep);
-
-			for (auto& b : stage.m_startBallsInWorld) {
-				if (b.body.isEmpty()) {
-					b.timeSinceEnteredGoal = none;
-					continue;
-				}
-				const Vec2 pos = b.body.getPos();
-				bool inGoal = false;
-				for (const auto& g : stage.m_goalAreas) {
-					if (g.rect.contains(pos)) {
-						inGoal = true;
-						break;
-					}
-				}
-				if (inGoal) {
-					if (b.timeSinceEnteredGoal) {
-						*b.timeSinceEnteredGoal += Stage::simulationTimeStep;
-					}
-					else {
-						b.timeSinceEnteredGoal = 0.0;
-					}
-				}
-				else {
-					b.timeSinceEnteredGoal = none;
-				}
-			}
-
-			if (stage.m_currentQueryIndex < stage.m_queries->size()) {
-				(*stage.m_queries)[stage.m_currentQueryIndex]->update(stage, Stage::simulationTimeStep);
-			}
-
-			for (auto& c : stage.m_startBallsInWorld) {
-				Vec2 vel = c.body.getVelocity();
-				double angleV = c.body.getAngularVelocity();
-				if (abs(vel.y) < 0.001 and abs(vel.x) < 2 and abs(angleV) < 0.1) {
-					c.body.setVelocity({ 0,0 });
-					c.body.setAngularVelocity(0);
-				}
-			}
-		}
-	}
+	SimulationEngine{ stage }.advance(dt);
 }
 
 void LeaderboardScene::drawViewer(const Game& game) const
@@ -589,7 +548,12 @@ void LeaderboardScene::drawViewer(const Game& game) const
 		const ScopedRenderStates2D rasterizer{ rs };
 
 		auto cameraTf = m_viewerCamera.createTransformer();
-		m_viewerEditUI.drawWorld(stage, m_viewerCamera);
+		if (m_viewerPlayer.isActive()) {
+			m_viewerEditUI.drawPlayback(stage, m_viewerPlayer.currentFrames(stage));
+		}
+		else {
+			m_viewerEditUI.drawWorld(stage, m_viewerCamera);
+		}
 	}
 
 	// ツールバー
@@ -628,12 +592,20 @@ void LeaderboardScene::drawViewer(const Game& game) const
 	ColorF pauseColor = stage.m_isSimulationPaused ? ColorF(0.7, 0.6, 0.2) : ColorF(0.8, 0.5, 0.2);
 	drawButton(m_simulationPauseButtonRect, pauseText, pauseIcon, pauseColor, simRunning, m_simulationPauseButtonRect.mouseOver());
 
-	drawButton(m_simulationStopButtonRect, U"Stop", U"\uF04D", ColorF(0.7, 0.3, 0.3), simRunning, m_simulationStopButtonRect.mouseOver());
+	drawButton(m_simulationStopButtonRect, U"Stop", U"\uF04D", ColorF(0.7, 0.3, 0.3), simRunning || m_viewerPlayer.isActive(), m_simulationStopButtonRect.mouseOver());
 
 	String ffText = U"{}x"_fmt(static_cast<int>(kSimulationSpeeds[m_speedIndex]));
 	ColorF ffColor = m_speedIndex != 0 ? ColorF(0.3, 0.6, 0.8) : ColorF(0.4, 0.5, 0.6);
 	drawButton(m_simulationFastForwardButtonRect, ffText, U"\uF04E", ffColor, true, m_simulationFastForwardButtonRect.mouseOver());
 
+	// リプレイ
+	if (m_viewerPlayer.isActive()) {
+		m_viewerPlayer.draw(stage);
+	}
+	else if (!simRunning && stage.hasTrajectoryRecording()) {
+		drawButton(m_replayButtonRect, U"Replay", U"\uF1DA", ColorF(0.3, 0.55, 0.75), true, m_replayButtonRect.mouseOver());
+	}
+
 	// クエリパネル
 	m_viewerQueryPanel.draw(stage);
 
@@ -4,6 +4,7 @@
 # include "InputUtils.hpp"
 # include "ScrollBar.h"
 # include "QueryPanel.h"
+# include "TrajectoryPlayer.h"
 # include "MyCamera2D.h"
 # include "StageEditUI.h"
 # include "Stage.hpp"
@@ -48,6 +49,9 @@ private:
 	QueryPanel m_viewerQueryPanel;
 	bool m_singleQueryMode = false;
 
+	// 記録した軌跡のリプレイ（物理演算なしで再生・シークする）
+	TrajectoryPlayer m_viewerPlayer;
+
 	// シミュレーション速度
 	int32 m_speedIndex = 0;
 
@@ -66,6 +70,7 @@ private:
 	RectF m_simulationPauseButtonRect{ 0, 0, 0, 0 };
 	RectF m_simulationStopButtonRect{ 0, 0, 0, 0 };
 	RectF m_simulationFastForwardButtonRect{ 0, 0, 0, 0 };
+	RectF m_replayButtonRect{ 0, 0, 0, 0 };
 	RectF m_queryPanelRect{ 0, 0, 0, 0 };
 	RectF m_loadButtonRect{ 0, 0, 0, 0 };
 
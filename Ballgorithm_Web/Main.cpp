@@ -2,6 +2,7 @@
 # include "Game.hpp"
 # include "Touches.h"
 # include "IndexedDB.hpp"
+# include "HeadlessVerify.hpp"
 
 # if SIV3D_PLATFORM(WEB)
 EM_JS(void, setupMultiTouchHandler, (), {
@@ -88,6 +89,14 @@ void Main()
 	FontAsset::Register(U"Icon", FontMethod::MSDF, 18, Typeface::Icon_Awesome_Solid);
 
 	Game game;
+
+# if not SIV3D_PLATFORM(WEB)
+	// コマンドライン検証モード（描画ループに入らず結果を出力して終了）
+	if (IsHeadlessVerifyRequested(System::GetCommandLineArgs())) {
+		RunHeadlessVerify(game, System::GetCommandLineArgs());
+		return;
+	}
+# endif
 	
 	Scene::SetBackground(ColorF(0.08, 0.1, 0.14));
 	//Scene::SetBackground(Palette::Papayawhip);
@@ -0,0 +1,131 @@
+﻿# include "NonEditableAreaIndex.hpp"
+
+namespace
+{
+	RectF BoundsOf(const Line& line)
+	{
+		return RectF::FromPoints(
+			Vec2{ Min(line.begin.x, line.end.x), Min(line.begin.y, line.end.y) },
+			Vec2{ Max(line.begin.x, line.end.x), Max(line.begin.y, line.end.y) });
+	}
+
+	// 辺上で接する場合も候補に残す（厳密判定は RectF 側に任せる）
+	bool BoundsOverlap(const RectF& a, const RectF& b)
+	{
+		return a.x <= b.x + b.w && b.x <= a.x + a.w
+			&& a.y <= b.y + b.h && b.y <= a.y + a.h;
+	}
+}
+
+NonEditableAreaIndex::NonEditableAreaIndex(const Array<RectF>& rects)
+	: m_rects(rects)
+	, m_stamps(rects.size(), 0)
+{
+	for (int32 i = 0; i < m_rects.size(); ++i) {
+		const Point tl = CellOf(m_rects[i].tl());
+		const Point br = CellOf(m_rects[i].br());
+		for (int32 y = tl.y; y <= br.y; ++y) {
+			for (int32 x = tl.x; x <= br.x; ++x) {
+				m_cells[Point{ x, y }].push_back(i);
+			}
+		}
+	}
+}
+
+bool NonEditableAreaIndex::containsPoint(const Vec2& pos) const
+{
+	if (m_rects.empty()) {
+		return false;
+	}
+
+	auto it = m_cells.find(CellOf(pos));
+	if (it == m_cells.end()) {
+		return false;
+	}
+	for (int32 i : it->second) {
+		if (m_rects[i].contains(pos)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool NonEditableAreaIndex::isLineAllowed(const Line& line) const
+{
+	if (m_rects.empty()) {
+		return true;
+	}
+
+	return isLineAllowedAgainst(line, BoundsOf(line));
+}
+
+bool NonEditableAreaIndex::areLinesAllowed(const Array<Line>& lines) const
+{
+	if (m_rects.empty()) {
+		return true;
+	}
+
+	for (const auto& line : lines) {
+		if (not isLineAllowedAgainst(line, BoundsOf(line))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+Point NonEditableAreaIndex::CellOf(const Vec2& pos)
+{
+	return Point{ static_cast<int32>(Math::Floor(pos.x / CellSize)), static_cast<int32>(Math::Floor(pos.y / CellSize)) };
+}
+
+void NonEditableAreaIndex::collectCandidates(const RectF& bounds) const
+{
+	m_candidates.clear();
+
+	const Point tl = CellOf(bounds.tl());
+	const Point br = CellOf(bounds.br());
+	const int64 cellCount = (static_cast<int64>(br.x) - tl.x + 1) * (static_cast<int64>(br.y) - tl.y + 1);
+
+	// セルを引くほうが高くつく長い線分は、全エリアをそのまま候補にする
+	if (static_cast<int64>(m_rects.size()) <= cellCount) {
+		for (int32 i = 0; i < m_rects.size(); ++i) {
+			m_candidates.push_back(i);
+		}
+		return;
+	}
+
+	// 複数のセルに掛かるエリアは1回だけ入れる
+	if (++m_stamp == 0) {
+		m_stamps.fill(0);
+		m_stamp = 1;
+	}
+	for (int32 y = tl.y; y <= br.y; ++y) {
+		for (int32 x = tl.x; x <= br.x; ++x) {
+			auto it = m_cells.find(Point{ x, y });
+			if (it == m_cells.end()) {
+				continue;
+			}
+			for (int32 i : it->second) {
+				if (m_stamps[i] != m_stamp) {
+					m_stamps[i] = m_stamp;
+					m_candidates.push_back(i);
+				}
+			}
+		}
+	}
+}
+
+bool NonEditableAreaIndex::isLineAllowedAgainst(const Line& line, const RectF& lineBounds) const
+{
+	collectCandidates(lineBounds);
+	for (int32 i : m_candidates) {
+		const RectF& rect = m_rects[i];
+		if (not BoundsOverlap(rect, lineBounds)) {
+			continue;
+		}
+		if (rect.contains(line.begin) || rect.contains(line.end) || rect.intersects(line)) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,38 @@
+﻿#pragma once
+
+# include <Siv3D.hpp>
+
+// 編集不可エリアの空間インデックス
+// 点は一様グリッドの1セルだけを調べ、線分は外接矩形が掛かるセルから候補のエリアを拾ってから厳密に判定する
+// エリアはステージ構築時に決まって以降ほぼ変わらないので、作り直しは Stage 側の無効化に任せる
+class NonEditableAreaIndex {
+public:
+	NonEditableAreaIndex() = default;
+	explicit NonEditableAreaIndex(const Array<RectF>& rects);
+
+	// 構築に使ったエリアの数（無効化漏れの検出用）
+	int32 areaCount() const { return static_cast<int32>(m_rects.size()); }
+
+	// pos がどれかのエリアに入っているか
+	bool containsPoint(const Vec2& pos) const;
+
+	// 線分が端点も含めてどのエリアにも掛からないか
+	bool isLineAllowed(const Line& line) const;
+
+	// lines のすべてが isLineAllowed か
+	// 候補は線分ごとに拾う（全体の外接矩形で絞ると、散らばった線分では全エリアが候補になる）
+	bool areLinesAllowed(const Array<Line>& lines) const;
+
+private:
+	static constexpr double CellSize = 128.0;
+
+	Array<RectF> m_rects;
+	HashTable<Point, Array<int32>> m_cells;  // セル → そのセルに掛かるエリア（昇順）
+	mutable Array<int32> m_candidates;       // 候補集めの作業用
+	mutable Array<uint32> m_stamps;          // エリア → 最後に候補に入れたときの m_stamp（重複を除く）
+	mutable uint32 m_stamp = 0;
+
+	static Point CellOf(const Vec2& pos);
+	void collectCandidates(const RectF& bounds) const;
+	bool isLineAllowedAgainst(const Line& line, const RectF& lineBounds) const;
+};
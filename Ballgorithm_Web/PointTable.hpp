@@ -0,0 +1,40 @@
+﻿#pragma once
+
+# include <Siv3D.hpp>
+# include "SlotTable.hpp"
+
+// 点ID → 座標 の表
+// ID を添字にした SlotTable。削除した点の ID は次に追加する点で使い回す
+class PointTable : public SlotTable<Vec2> {
+public:
+	PointTable() = default;
+
+	// 保存形式（ID → 座標）から作る。範囲外の ID は例外
+	explicit PointTable(const HashTable<int32, Vec2>& points)
+	{
+		for (const auto& [id, pos] : points) {
+			emplaceAt(id, pos);
+		}
+	}
+
+	// ids の点をまとめて動かす（ids はすべて生きている点であること）
+	void translate(const Array<int32>& ids, const Vec2& delta)
+	{
+		for (int32 id : ids) {
+			(*this)[id] += delta;
+		}
+	}
+
+	// 保存・送信用（形式は従来の HashTable のまま）
+	HashTable<int32, Vec2> toHashTable() const
+	{
+		HashTable<int32, Vec2> result;
+		result.reserve(size());
+		for (const auto& [id, pos] : *this) {
+			result.emplace(id, pos);
+		}
+		return result;
+	}
+
+	bool operator==(const PointTable&) const = default;
+};
@@ -2,23 +2,38 @@
 # include "Stage.hpp"
 
 namespace {
+	// ゴールごとの在室数は GoalAreaIndex がステップごとに差分で更新している
 	static bool CheckGoalRequirements(const Stage& stage, const Array<GoalRequirement>& goalRequirements)
 	{
-		Array<Array<BallKind>> reachedGoalAreas(stage.m_goalAreas.size());
-		for (auto [i, r] : Indexed(stage.m_goalAreas)) {
-			for (const auto& c : stage.m_startBallsInWorld) {
-				if (r.rect.contains(c.body.getPos())) {
-					reachedGoalAreas[i].push_back(c.kind);
-				}
+		if (stage.m_goalAreas.size() != goalRequirements.size()) {
+			return false;
+		}
+
+		for (int32 i = 0; i < goalRequirements.size(); ++i) {
+			if (!goalRequirements[i].isSatisfiedBy(stage.m_goalAreaIndex.occupancy(i).counts)) {
+				return false;
 			}
 		}
 
-		if (reachedGoalAreas.size() != goalRequirements.size()) {
+		return true;
+	}
+
+	// ゴールごとに「指定した種類のボールがちょうど1つ」または「何も入っていない」かをチェック
+	static bool CheckSingleBallGoals(const Stage& stage, const Array<Optional<BallKind>>& goalAreaToBeFilled)
+	{
+		if (stage.m_goalAreas.size() != goalAreaToBeFilled.size()) {
 			return false;
 		}
 
-		for (int32 i = 0; i < goalRequirements.size(); ++i) {
-			if (!goalRequirements[i].isSatisfiedBy(reachedGoalAreas[i])) {
+		for (int32 i = 0; i < goalAreaToBeFilled.size(); ++i) {
+			const auto& requiredKind = goalAreaToBeFilled[i];
+			const auto& occupancy = stage.m_goalAreaIndex.occupancy(i);
+			if (requiredKind) {
+				if (not (occupancy.total == 1 and occupancy.countOf(*requiredKind) == 1)) {
+					return false;
+				}
+			}
+			else if (occupancy.total != 0) {
 				return false;
 			}
 		}
@@ -26,6 +41,17 @@ namespace {
 		return true;
 	}
 
+	// update と同じ足し方で経過時間を進め、delay に達するまでの回数を数える（浮動小数点の誤差まで一致させる）
+	static int32 StepsUntilDelayElapsed(double elapsed, double delay, double dt)
+	{
+		int32 steps = 0;
+		do {
+			elapsed += dt;
+			++steps;
+		} while (elapsed < delay);
+		return steps;
+	}
+
 } // End of anonymous namespace
 
 double MultiPhaseQuery::getPanelHeight() const
@@ -59,7 +85,7 @@ double MultiPhaseQuery::getPanelHeight() const
 	return Max(80.0, total);
 }
 
-double MultiPhaseQuery::drawPanelContent(const RectF& queryRect, bool isActive) const
+double MultiPhaseQuery::drawPanelContent(const RectF& queryRect, bool isActive, const QueryRunState& state) const
 {
 	const double colWidth = 26.0;
 	const double rowHeight = 20.0;
@@ -99,15 +125,15 @@ double MultiPhaseQuery::drawPanelContent(const RectF& queryRect, bool isActive)
 
 		// Active highlight for current phase/release
 		Optional<int32> activeRow = none;
-		if (isActive && phaseIndex == m_phaseIndex && (phase.releases.size() >= 2 or m_phases.size() >= 2)) {
-			if (m_nextReleaseIndex == 0) {
+		if (isActive && phaseIndex == state.phaseIndex && (phase.releases.size() >= 2 or m_phases.size() >= 2)) {
+			if (state.nextReleaseIndex == 0) {
 				// none
 			}
-			else if (m_nextReleaseIndex >= phase.releases.size()) {
+			else if (state.nextReleaseIndex >= phase.releases.size()) {
 				activeRow = phase.releases.size() - 1;
 			}
 			else {
-				activeRow = m_nextReleaseIndex - 1;
+				activeRow = state.nextReleaseIndex - 1;
 			}
 		}
 		const ColorF activeRowBg = ColorF(0.35, 0.45, 0.9, 0.12);
@@ -216,8 +242,8 @@ double MultiPhaseQuery::drawPanelContent(const RectF& queryRect, bool isActive)
 		}
 
 		// Result marker (if decided)
-		if (phaseIndex < m_phaseResults.size() && m_phaseResults[phaseIndex].has_value()) {
-			const bool ok = m_phaseResults[phaseIndex].value();
+		if (phaseIndex < state.phaseResults.size() && state.phaseResults[phaseIndex].has_value()) {
+			const bool ok = state.phaseResults[phaseIndex].value();
 			Circle checkBg{ queryRect.x + 38 - 16, reqY + maxIconHeight / 2.0, 7 };
 			checkBg.draw(ok ? ColorF(0.2, 0.6, 0.3) : ColorF(0.6, 0.25, 0.25));
 			FontAsset(U"Regular")(ok ? U"✓" : U"✗").drawAt(10, checkBg.center, Palette::White);
@@ -237,58 +263,31 @@ double MultiPhaseQuery::drawPanelContent(const RectF& queryRect, bool isActive)
 	return getPanelHeight();
 }
 
-void SampleQuery::startSimulation(Stage& stage)
+void SampleQuery::startSimulation(Stage& stage, [[maybe_unused]] QueryRunState& state) const
 {
 	for (int32 i = 0; i < Min(m_startBalls.size(), stage.m_startCircles.size()); ++i) {
-		const auto& state = m_startBalls[i];
-		if (not state) continue;
+		const auto& startBall = m_startBalls[i];
+		if (not startBall) continue;
 		const auto& pos = stage.m_startCircles[i].circle.center;
-		auto circleBody = createCircle(stage.m_world, P2Dynamic, Circle{ pos, state->radius() });
-		stage.m_startBallsInWorld.push_back(Ball{ circleBody, state->kind });
+		auto circleBody = createCircle(stage.m_world, P2Dynamic, Circle{ pos, startBall->radius() });
+		stage.m_startBallsInWorld.push_back(Ball{ circleBody, startBall->kind });
 	}
 }
 
-void SampleQuery::update(Stage& stage, double dt)
+void SampleQuery::update(Stage& stage, QueryRunState& state, double dt) const
 {
 	// SampleQuery は一度に全てのボールを放出するため、updateでは何もしない
 	(void)stage;
+	(void)state;
 	(void)dt;
 }
 
-bool SampleQuery::checkSimulationResult(const Stage& stage)
+bool SampleQuery::checkSimulationResult(const Stage& stage, [[maybe_unused]] const QueryRunState& state) const
 {
-	Array<Array<BallKind>> reachedGoalAreas(stage.m_goalAreas.size());
-	for (auto [i, r] : Indexed(stage.m_goalAreas)) {
-		for (const auto& c : stage.m_startBallsInWorld) {
-			if (r.rect.contains(c.body.getPos())) {
-				reachedGoalAreas[i].push_back(c.kind);
-			}
-		}
-	}
-	if (reachedGoalAreas.size() == m_goalAreaToBeFilled.size()) {
-		bool allOk = true;
-		for (int32 i = 0; i < m_goalAreaToBeFilled.size(); ++i) {
-			const auto& requiredKind = m_goalAreaToBeFilled[i];
-			const auto& reachedKinds = reachedGoalAreas[i];
-			if (requiredKind) {
-				if (reachedKinds.size() == 1 and requiredKind.value() == reachedKinds[0]) {
-					// OK
-				}
-				else { allOk = false; break; }
-			}
-			else {
-				if (reachedKinds.size() == 0) {
-					// OK
-				}
-				else { allOk = false; break; }
-			}
-		}
-		return allOk;
-	}
-	return false;
+	return CheckSingleBallGoals(stage, m_goalAreaToBeFilled);
 }
 
-double SampleQuery::drawPanelContent(const RectF& queryRect, bool isActive) const
+double SampleQuery::drawPanelContent(const RectF& queryRect, [[maybe_unused]] bool isActive, [[maybe_unused]] const QueryRunState& state) const
 {
 	// 入力ボール表示
 	double ballX = queryRect.x + 38;
@@ -367,12 +366,12 @@ SequentialQuery::SequentialQuery(
 {
 }
 
-void SequentialQuery::startSimulation(Stage& stage)
+void SequentialQuery::startSimulation(Stage& stage, QueryRunState& state) const
 {
 	// 状態を初期化
-	m_nextReleaseIndex = 0;
-	m_timeSinceLastRelease = 0.0;
-	m_waitingForAllStopped = false;
+	state.nextReleaseIndex = 0;
+	state.timeSinceLastRelease = 0.0;
+	state.waitingForAllStopped = false;
 	
 	if (m_releases.empty()) return;
 	
@@ -382,105 +381,77 @@ void SequentialQuery::startSimulation(Stage& stage)
 		// delay が none = 全ボール停止待ち
 		// 最初のイベントの場合は即時放出
 		releaseBalls(stage, 0);
-		m_nextReleaseIndex = 1;
-		m_timeSinceLastRelease = 0.0;
+		state.nextReleaseIndex = 1;
+		state.timeSinceLastRelease = 0.0;
 		
 		// 次のイベントがあれば待機状態を設定
-		if (m_nextReleaseIndex < m_releases.size()) {
-			if (!m_releases[m_nextReleaseIndex].delay.has_value()) {
-				m_waitingForAllStopped = true;
+		if (state.nextReleaseIndex < m_releases.size()) {
+			if (!m_releases[state.nextReleaseIndex].delay.has_value()) {
+				state.waitingForAllStopped = true;
 			}
 		}
 	}
 	else if (release.delay.value() <= 0.0) {
 		// delay = 0 は即時放出
 		releaseBalls(stage, 0);
-		m_nextReleaseIndex = 1;
-		m_timeSinceLastRelease = 0.0;
+		state.nextReleaseIndex = 1;
+		state.timeSinceLastRelease = 0.0;
 	}
 }
 
-void SequentialQuery::update(Stage& stage, double dt)
+void SequentialQuery::update(Stage& stage, QueryRunState& state, double dt) const
 {
-	if (m_nextReleaseIndex >= m_releases.size()) {
+	if (state.nextReleaseIndex >= m_releases.size()) {
 		// 全てのボールを放出済み
 		return;
 	}
 	
-	const auto& release = m_releases[m_nextReleaseIndex];
+	const auto& release = m_releases[state.nextReleaseIndex];
 	
-	if (m_waitingForAllStopped) {
+	if (state.waitingForAllStopped) {
 		// 全ボール停止を待機中
 		if (areAllBallsStopped(stage)) {
 			// 全ボール停止したので次を放出
-			releaseBalls(stage, m_nextReleaseIndex);
-			m_nextReleaseIndex++;
-			m_timeSinceLastRelease = 0.0;
-			m_waitingForAllStopped = false;
+			releaseBalls(stage, state.nextReleaseIndex);
+			state.nextReleaseIndex++;
+			state.timeSinceLastRelease = 0.0;
+			state.waitingForAllStopped = false;
 			
 			// 次のイベントの待機モードを設定
-			if (m_nextReleaseIndex < m_releases.size()) {
-				if (!m_releases[m_nextReleaseIndex].delay.has_value()) {
-					m_waitingForAllStopped = true;
+			if (state.nextReleaseIndex < m_releases.size()) {
+				if (!m_releases[state.nextReleaseIndex].delay.has_value()) {
+					state.waitingForAllStopped = true;
 				}
 			}
 		}
 	}
 	else if (release.delay.has_value()) {
 		// 時間遅延を待機中
-		m_timeSinceLastRelease += dt;
+		state.timeSinceLastRelease += dt;
 		
-		if (m_timeSinceLastRelease >= release.delay.value()) {
+		if (state.timeSinceLastRelease >= release.delay.value()) {
 			// 時間経過したので放出
-			releaseBalls(stage, m_nextReleaseIndex);
-			m_nextReleaseIndex++;
-			m_timeSinceLastRelease = 0.0;
+			releaseBalls(stage, state.nextReleaseIndex);
+			state.nextReleaseIndex++;
+			state.timeSinceLastRelease = 0.0;
 			
 			// 次のイベントの待機モードを設定
-			if (m_nextReleaseIndex < m_releases.size()) {
-				if (!m_releases[m_nextReleaseIndex].delay.has_value()) {
-					m_waitingForAllStopped = true;
+			if (state.nextReleaseIndex < m_releases.size()) {
+				if (!m_releases[state.nextReleaseIndex].delay.has_value()) {
+					state.waitingForAllStopped = true;
 				}
 			}
 		}
 	}
 	else {
 		// delay が none = 全ボール停止待ち開始
-		m_waitingForAllStopped = true;
+		state.waitingForAllStopped = true;
 	}
 }
 
-bool SequentialQuery::checkSimulationResult(const Stage& stage)
+bool SequentialQuery::checkSimulationResult(const Stage& stage, const QueryRunState& state) const
 {
-	Array<Array<BallKind>> reachedGoalAreas(stage.m_goalAreas.size());
-	for (auto [i, r] : Indexed(stage.m_goalAreas)) {
-		for (const auto& c : stage.m_startBallsInWorld) {
-			if (r.rect.contains(c.body.getPos())) {
-				reachedGoalAreas[i].push_back(c.kind);
-			}
-		}
-	}
-	if (reachedGoalAreas.size() == m_goalAreaToBeFilled.size()) {
-		bool allOk = true;
-		for (int32 i = 0; i < m_goalAreaToBeFilled.size(); ++i) {
-			const auto& requiredKind = m_goalAreaToBeFilled[i];
-			const auto& reachedKinds = reachedGoalAreas[i];
-			if (requiredKind) {
-				if (reachedKinds.size() == 1 and requiredKind.value() == reachedKinds[0]) {
-					// OK
-				}
-				else { allOk = false; break; }
-			}
-			else {
-				if (reachedKinds.size() == 0) {
-					// OK
-				}
-				else { allOk = false; break; }
-			}
-		}
-		return allOk;
-	}
-	return false;
+	return CheckSingleBallGoals(stage, m_goalAreaToBeFilled);
 }
 
 Array<Optional<StartBallState>> SequentialQuery::getStartBalls() const
@@ -504,7 +475,7 @@ double SequentialQuery::getPanelHeight() const
 	return 35.0 + inputAreaHeight + outputAreaHeight;
 }
 
-double SequentialQuery::drawPanelContent(const RectF& queryRect, bool isActive) const
+double SequentialQuery::drawPanelContent(const RectF& queryRect, bool isActive, const QueryRunState& state) const
 {
 	// StartCircleの数を取得（最初の放出イベントから）
 	int32 numStartCircles = 0;
@@ -524,14 +495,14 @@ double SequentialQuery::drawPanelContent(const RectF& queryRect, bool isActive)
 	// 現在の段階（ボール放出中/待機中）の行を計算
 	Optional<int32> activeRow = none;
 	if (m_releases.size() >= 2 and isActive) {
-		if (m_nextReleaseIndex == 0) {
+		if (state.nextReleaseIndex == 0) {
 			// activeRow = 0;
 		}
-		else if (m_nextReleaseIndex >= m_releases.size()) {
+		else if (state.nextReleaseIndex >= m_releases.size()) {
 			activeRow = m_releases.size() - 1;
 		}
 		else {
-			activeRow = m_nextReleaseIndex - 1;
+			activeRow = state.nextReleaseIndex - 1;
 		}
 	}
 
@@ -640,12 +611,24 @@ double SequentialQuery::drawPanelContent(const RectF& queryRect, bool isActive)
 	return getPanelHeight();
 }
 
-bool SequentialQuery::hasFinishedReleasing() const
+bool SequentialQuery::hasFinishedReleasing(const QueryRunState& state) const
 {
-	return m_nextReleaseIndex >= m_releases.size();
+	return state.nextReleaseIndex >= m_releases.size();
 }
 
-void SequentialQuery::releaseBalls(Stage& stage, int32 releaseIndex)
+Optional<int32> SequentialQuery::stepsUntilTimedRelease(const QueryRunState& state, double dt) const
+{
+	if (state.nextReleaseIndex >= m_releases.size() || state.waitingForAllStopped) {
+		return none;
+	}
+	const auto& release = m_releases[state.nextReleaseIndex];
+	if (not release.delay) {
+		return none;
+	}
+	return StepsUntilDelayElapsed(state.timeSinceLastRelease, *release.delay, dt);
+}
+
+void SequentialQuery::releaseBalls(Stage& stage, int32 releaseIndex) const
 {
 	if (releaseIndex >= m_releases.size()) return;
 	
@@ -690,96 +673,96 @@ MultiPhaseQuery::MultiPhaseQuery(const Array<MultiPhaseQuery::Phase>& phases)
 {
 }
 
-void MultiPhaseQuery::startSimulation(Stage& stage)
+void MultiPhaseQuery::startSimulation(Stage& stage, QueryRunState& state) const
 {
-	m_phaseIndex = 0;
-	m_nextReleaseIndex = 0;
-	m_timeSinceLastRelease = 0.0;
-	m_waitingForAllStopped = false;
-	m_phaseResults.assign(m_phases.size(), none);
+	state.phaseIndex = 0;
+	state.nextReleaseIndex = 0;
+	state.timeSinceLastRelease = 0.0;
+	state.waitingForAllStopped = false;
+	state.phaseResults.assign(m_phases.size(), none);
 
 	if (m_phases.empty()) {
 		return;
 	}
 
-	startPhase(stage, 0);
+	startPhase(stage, state, 0);
 }
 
-void MultiPhaseQuery::startPhase(Stage& stage, int32 phaseIndex)
+void MultiPhaseQuery::startPhase(Stage& stage, QueryRunState& state, int32 phaseIndex) const
 {
 	(void)stage;
-	m_phaseIndex = phaseIndex;
-	m_nextReleaseIndex = 0;
-	m_timeSinceLastRelease = 0.0;
-	m_waitingForAllStopped = false;
+	state.phaseIndex = phaseIndex;
+	state.nextReleaseIndex = 0;
+	state.timeSinceLastRelease = 0.0;
+	state.waitingForAllStopped = false;
 
-	if (m_phaseIndex >= m_phases.size()) {
+	if (state.phaseIndex >= m_phases.size()) {
 		return;
 	}
 
-	const auto& phase = m_phases[m_phaseIndex];
+	const auto& phase = m_phases[state.phaseIndex];
 	if (phase.releases.empty()) {
 		// 放出が無い場合も「停止待ち→ゴール確認」で進める
-		m_waitingForAllStopped = true;
+		state.waitingForAllStopped = true;
 		return;
 	}
 
 	const auto& release0 = phase.releases[0];
 	if (!release0.delay.has_value() || release0.delay.value() <= 0.0) {
-		releaseBalls(stage, m_phaseIndex, 0);
-		m_nextReleaseIndex = 1;
-		m_timeSinceLastRelease = 0.0;
+		releaseBalls(stage, state.phaseIndex, 0);
+		state.nextReleaseIndex = 1;
+		state.timeSinceLastRelease = 0.0;
 
-		if (m_nextReleaseIndex < phase.releases.size()) {
-			if (!phase.releases[m_nextReleaseIndex].delay.has_value()) {
-				m_waitingForAllStopped = true;
+		if (state.nextReleaseIndex < phase.releases.size()) {
+			if (!phase.releases[state.nextReleaseIndex].delay.has_value()) {
+				state.waitingForAllStopped = true;
 			}
 		}
 	}
 }
 
-void MultiPhaseQuery::update(Stage& stage, double dt)
+void MultiPhaseQuery::update(Stage& stage, QueryRunState& state, double dt) const
 {
-	if (m_phaseIndex >= m_phases.size()) {
+	if (state.phaseIndex >= m_phases.size()) {
 		return;
 	}
 
-	const auto& phase = m_phases[m_phaseIndex];
+	const auto& phase = m_phases[state.phaseIndex];
 
 	// 1) 現フェーズの放出更新
-	if (m_nextReleaseIndex < phase.releases.size()) {
-		const auto& nextRelease = phase.releases[m_nextReleaseIndex];
+	if (state.nextReleaseIndex < phase.releases.size()) {
+		const auto& nextRelease = phase.releases[state.nextReleaseIndex];
 
-		if (m_waitingForAllStopped) {
+		if (state.waitingForAllStopped) {
 			if (areAllBallsStopped(stage)) {
-				releaseBalls(stage, m_phaseIndex, m_nextReleaseIndex);
-				m_nextReleaseIndex++;
-				m_timeSinceLastRelease = 0.0;
-				m_waitingForAllStopped = false;
-
-				if (m_nextReleaseIndex < phase.releases.size()) {
-					if (!phase.releases[m_nextReleaseIndex].delay.has_value()) {
-						m_waitingForAllStopped = true;
+				releaseBalls(stage, state.phaseIndex, state.nextReleaseIndex);
+				state.nextReleaseIndex++;
+				state.timeSinceLastRelease = 0.0;
+				state.waitingForAllStopped = false;
+
+				if (state.nextReleaseIndex < phase.releases.size()) {
+					if (!phase.releases[state.nextReleaseIndex].delay.has_value()) {
+						state.waitingForAllStopped = true;
 					}
 				}
 			}
 		}
 		else if (nextRelease.delay.has_value()) {
-			m_timeSinceLastRelease += dt;
-			if (m_timeSinceLastRelease >= nextRelease.delay.value()) {
-				releaseBalls(stage, m_phaseIndex, m_nextReleaseIndex);
-				m_nextReleaseIndex++;
-				m_timeSinceLastRelease = 0.0;
-
-				if (m_nextReleaseIndex < phase.releases.size()) {
-					if (!phase.releases[m_nextReleaseIndex].delay.has_value()) {
-						m_waitingForAllStopped = true;
+			state.timeSinceLastRelease += dt;
+			if (state.timeSinceLastRelease >= nextRelease.delay.value()) {
+				releaseBalls(stage, state.phaseIndex, state.nextReleaseIndex);
+				state.nextReleaseIndex++;
+				state.timeSinceLastRelease = 0.0;
+
+				if (state.nextReleaseIndex < phase.releases.size()) {
+					if (!phase.releases[state.nextReleaseIndex].delay.has_value()) {
+						state.waitingForAllStopped = true;
 					}
 				}
 			}
 		}
 		else {
-			m_waitingForAllStopped = true;
+			state.waitingForAllStopped = true;
 		}
 
 		return;
@@ -790,17 +773,17 @@ void MultiPhaseQuery::update(Stage& stage, double dt)
 		return;
 	}
 
-	if (!m_phaseResults[m_phaseIndex].has_value()) {
-		m_phaseResults[m_phaseIndex] = checkGoalForPhase(stage, m_phaseIndex);
+	if (!state.phaseResults[state.phaseIndex].has_value()) {
+		state.phaseResults[state.phaseIndex] = checkGoalForPhase(stage, state.phaseIndex);
 	}
 
 	// 次フェーズへ
-	const int32 nextPhase = m_phaseIndex + 1;
+	const int32 nextPhase = state.phaseIndex + 1;
 	if (nextPhase < m_phases.size()) {
-		startPhase(stage, nextPhase);
+		startPhase(stage, state, nextPhase);
 	}
 	else {
-		m_phaseIndex = m_phases.size();
+		state.phaseIndex = m_phases.size();
 	}
 }
 
@@ -812,7 +795,7 @@ bool MultiPhaseQuery::checkGoalForPhase(const Stage& stage, int32 phaseIndex) co
 	return CheckGoalRequirements(stage, m_phases[phaseIndex].goalRequirements);
 }
 
-bool MultiPhaseQuery::checkSimulationResult(const Stage& stage)
+bool MultiPhaseQuery::checkSimulationResult(const Stage& stage, const QueryRunState& state) const
 {
 	(void)stage;
 	if (m_phases.empty()) {
@@ -820,7 +803,7 @@ bool MultiPhaseQuery::checkSimulationResult(const Stage& stage)
 	}
 
 	// 未確定が残っている場合は、結果はまだ確定しない（false扱い）
-	for (const auto& r : m_phaseResults) {
+	for (const auto& r : state.phaseResults) {
 		if (!r.has_value()) {
 			return false;
 		}
@@ -831,17 +814,34 @@ bool MultiPhaseQuery::checkSimulationResult(const Stage& stage)
 	return true;
 }
 
-bool MultiPhaseQuery::hasFinishedReleasing() const
+bool MultiPhaseQuery::hasFinishedReleasing(const QueryRunState& state) const
 {
 	if (m_phases.empty()) {
 		return true;
 	}
-	if (m_phaseIndex >= m_phases.size()) {
+	if (state.phaseIndex >= m_phases.size()) {
 		return true;
 	}
 	return false;
 }
 
+Optional<int32> MultiPhaseQuery::stepsUntilTimedRelease(const QueryRunState& state, double dt) const
+{
+	// 放出が終わったフェーズは停止待ち→ゴール確認に進むので早送りしない
+	if (state.phaseIndex >= m_phases.size() || state.waitingForAllStopped) {
+		return none;
+	}
+	const auto& releases = m_phases[state.phaseIndex].releases;
+	if (state.nextReleaseIndex >= releases.size()) {
+		return none;
+	}
+	const auto& release = releases[state.nextReleaseIndex];
+	if (not release.delay) {
+		return none;
+	}
+	return StepsUntilDelayElapsed(state.timeSinceLastRelease, *release.delay, dt);
+}
+
 Array<Optional<StartBallState>> MultiPhaseQuery::getStartBalls() const
 {
 	if (m_phases.empty() || m_phases[0].releases.empty()) {
@@ -869,7 +869,7 @@ Array<Optional<BallKind>> MultiPhaseQuery::getGoalRequirements() const
 	return result;
 }
 
-void MultiPhaseQuery::releaseBalls(Stage& stage, int32 phaseIndex, int32 releaseIndex)
+void MultiPhaseQuery::releaseBalls(Stage& stage, int32 phaseIndex, int32 releaseIndex) const
 {
 	if (phaseIndex >= m_phases.size()) return;
 	const auto& releases = m_phases[phaseIndex].releases;
@@ -916,12 +916,12 @@ MultiGoalSequentialQuery::MultiGoalSequentialQuery(
 {
 }
 
-void MultiGoalSequentialQuery::startSimulation(Stage& stage)
+void MultiGoalSequentialQuery::startSimulation(Stage& stage, QueryRunState& state) const
 {
 	// 状態を初期化
-	m_nextReleaseIndex = 0;
-	m_timeSinceLastRelease = 0.0;
-	m_waitingForAllStopped = false;
+	state.nextReleaseIndex = 0;
+	state.timeSinceLastRelease = 0.0;
+	state.waitingForAllStopped = false;
 	
 	if (m_releases.empty()) return;
 	
@@ -931,95 +931,86 @@ void MultiGoalSequentialQuery::startSimulation(Stage& stage)
 		// delay が none = 全ボール停止待ち
 		// 最初のイベントの場合は即時放出
 		releaseBalls(stage, 0);
-		m_nextReleaseIndex = 1;
-		m_timeSinceLastRelease = 0.0;
+		state.nextReleaseIndex = 1;
+		state.timeSinceLastRelease = 0.0;
 		
 		// 次のイベントがあれば待機状態を設定
-		if (m_nextReleaseIndex < m_releases.size()) {
-			if (!m_releases[m_nextReleaseIndex].delay.has_value()) {
-				m_waitingForAllStopped = true;
+		if (state.nextReleaseIndex < m_releases.size()) {
+			if (!m_releases[state.nextReleaseIndex].delay.has_value()) {
+				state.waitingForAllStopped = true;
 			}
 		}
 	}
 	else if (release.delay.value() <= 0.0) {
 		// delay = 0 は即時放出
 		releaseBalls(stage, 0);
-		m_nextReleaseIndex = 1;
-		m_timeSinceLastRelease = 0.0;
+		state.nextReleaseIndex = 1;
+		state.timeSinceLastRelease = 0.0;
 	}
 }
 
-void MultiGoalSequentialQuery::update(Stage& stage, double dt)
+void MultiGoalSequentialQuery::update(Stage& stage, QueryRunState& state, double dt) const
 {
-	if (m_nextReleaseIndex >= m_releases.size()) {
+	if (state.nextReleaseIndex >= m_releases.size()) {
 		return;
 	}
 	
-	const auto& release = m_releases[m_nextReleaseIndex];
+	const auto& release = m_releases[state.nextReleaseIndex];
 	
-	if (m_waitingForAllStopped) {
+	if (state.waitingForAllStopped) {
 		if (areAllBallsStopped(stage)) {
-			releaseBalls(stage, m_nextReleaseIndex);
-			m_nextReleaseIndex++;
-			m_timeSinceLastRelease = 0.0;
-			m_waitingForAllStopped = false;
+			releaseBalls(stage, state.nextReleaseIndex);
+			state.nextReleaseIndex++;
+			state.timeSinceLastRelease = 0.0;
+			state.waitingForAllStopped = false;
 			
-			if (m_nextReleaseIndex < m_releases.size()) {
-				if (!m_releases[m_nextReleaseIndex].delay.has_value()) {
-					m_waitingForAllStopped = true;
+			if (state.nextReleaseIndex < m_releases.size()) {
+				if (!m_releases[state.nextReleaseIndex].delay.has_value()) {
+					state.waitingForAllStopped = true;
 				}
 			}
 		}
 	}
 	else if (release.delay.has_value()) {
-		m_timeSinceLastRelease += dt;
+		state.timeSinceLastRelease += dt;
 		
-		if (m_timeSinceLastRelease >= release.delay.value()) {
-			releaseBalls(stage, m_nextReleaseIndex);
-			m_nextReleaseIndex++;
-			m_timeSinceLastRelease = 0.0;
+		if (state.timeSinceLastRelease >= release.delay.value()) {
+			releaseBalls(stage, state.nextReleaseIndex);
+			state.nextReleaseIndex++;
+			state.timeSinceLastRelease = 0.0;
 			
-			if (m_nextReleaseIndex < m_releases.size()) {
-				if (!m_releases[m_nextReleaseIndex].delay.has_value()) {
-					m_waitingForAllStopped = true;
+			if (state.nextReleaseIndex < m_releases.size()) {
+				if (!m_releases[state.nextReleaseIndex].delay.has_value()) {
+					state.waitingForAllStopped = true;
 				}
 			}
 		}
 	}
 	else {
-		m_waitingForAllStopped = true;
+		state.waitingForAllStopped = true;
 	}
 }
 
-bool MultiGoalSequentialQuery::checkSimulationResult(const Stage& stage)
+bool MultiGoalSequentialQuery::checkSimulationResult(const Stage& stage, const QueryRunState& state) const
 {
-	// 各ゴールエリアに入っているボールを収集
-	Array<Array<BallKind>> reachedGoalAreas(stage.m_goalAreas.size());
-	for (auto [i, r] : Indexed(stage.m_goalAreas)) {
-		for (const auto& c : stage.m_startBallsInWorld) {
-			if (r.rect.contains(c.body.getPos())) {
-				reachedGoalAreas[i].push_back(c.kind);
-			}
-		}
-	}
-	
-	if (reachedGoalAreas.size() != m_goalRequirements.size()) {
-		return false;
-	}
-	
-	// 各ゴールエリアの要件をチェック
-	for (int32 i = 0; i < m_goalRequirements.size(); ++i) {
-		if (!m_goalRequirements[i].isSatisfiedBy(reachedGoalAreas[i])) {
-			return false;
-		}
-	}
-	
-	return true;
+	return CheckGoalRequirements(stage, m_goalRequirements);
+}
+
+bool MultiGoalSequentialQuery::hasFinishedReleasing(const QueryRunState& state) const
+{
+	return state.nextReleaseIndex >= m_releases.size();
 }
 
-bool MultiGoalSequentialQuery::hasFinishedReleasing() const
+Optional<int32> MultiGoalSequentialQuery::stepsUntilTimedRelease(const QueryRunState& state, double dt) const
 {
-	return m_nextReleaseIndex >= m_releases.size();
+	if (state.nextReleaseIndex >= m_releases.size() || state.waitingForAllStopped) {
+		return none;
+	}
+	const auto& release = m_releases[state.nextReleaseIndex];
+	if (not release.delay) {
+		return none;
+	}
+	return StepsUntilDelayElapsed(state.timeSinceLastRelease, *release.delay, dt);
 }
 
 Array<Optional<StartBallState>> MultiGoalSequentialQuery::getStartBalls() const
@@ -1068,7 +1059,7 @@ double MultiGoalSequentialQuery::getPanelHeight() const
 	return 35.0 + inputAreaHeight + outputAreaHeight;
 }
 
-double MultiGoalSequentialQuery::drawPanelContent(const RectF& queryRect, bool isActive) const
+double MultiGoalSequentialQuery::drawPanelContent(const RectF& queryRect, bool isActive, const QueryRunState& state) const
 {
 	// StartCircleの数を取得
 	int32 numStartCircles = 0;
@@ -1087,14 +1078,14 @@ double MultiGoalSequentialQuery::drawPanelContent(const RectF& queryRect, bool i
 	// 現在の段階（ボール放出中/待機中）の行を計算
 	Optional<int32> activeRow = none;
 	if (m_releases.size() >= 2 and isActive) {
-		if (m_nextReleaseIndex == 0) {
+		if (state.nextReleaseIndex == 0) {
 			// activeRow = 0;
 		}
-		else if (m_nextReleaseIndex >= m_releases.size()) {
+		else if (state.nextReleaseIndex >= m_releases.size()) {
 			activeRow = m_releases.size() - 1;
 		}
 		else {
-			activeRow = m_nextReleaseIndex - 1;
+			activeRow = state.nextReleaseIndex - 1;
 		}
 	}
 	
@@ -1223,7 +1214,7 @@ double MultiGoalSequentialQuery::drawPanelContent(const RectF& queryRect, bool i
 	return getPanelHeight();
 }
 
-void MultiGoalSequentialQuery::releaseBalls(Stage& stage, int32 releaseIndex)
+void MultiGoalSequentialQuery::releaseBalls(Stage& stage, int32 releaseIndex) const
 {
 	if (releaseIndex >= m_releases.size()) return;
 	
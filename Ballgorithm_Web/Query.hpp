@@ -18,6 +18,10 @@ struct Ball {
 	
 	// ゴールに入ってからの経過時間（秒）。ゴール外なら none
 	Optional<double> timeSinceEnteredGoal;
+
+	// 現在入っているゴールエリアのインデックス（GoalAreaIndex が更新する）
+	Array<int32> goalIndices;
+	bool isRegisteredInGoals = false;
 	
 	bool isSmall() const { return kind == BallKind::Small; }
 	bool isLarge() const { return kind == BallKind::Large; }
@@ -82,7 +86,11 @@ struct GoalRequirement {
 		for (const auto& kind : actualBalls) {
 			actualCounts[kind]++;
 		}
-		
+		return isSatisfiedBy(actualCounts);
+	}
+
+	// 種類ごとのボール数が要件を満たすかチェック
+	bool isSatisfiedBy(const HashTable<BallKind, int32>& actualCounts) const {
 		// 要件と比較
 		// 1. 要件にある全ての種類について、正確な個数が必要
 		for (const auto& [kind, requiredCount] : ballCounts) {
@@ -106,15 +114,31 @@ struct GoalRequirement {
 
 class Stage;
 
+// クエリ1回の実行ごとの進行状態
+// クエリ定義（IQuery）は不変に保ち、実行ごとにこの状態を用意することで
+// 同じクエリを複数のステージ・スレッドで同時に実行できるようにする
+struct QueryRunState {
+	int32 phaseIndex = 0;                // 現在のフェーズ（MultiPhaseQuery用）
+	int32 nextReleaseIndex = 0;          // 次の放出インデックス
+	double timeSinceLastRelease = 0.0;   // 最後の放出からの経過時間
+	bool waitingForAllStopped = false;   // 全ボール停止待ちかどうか
+	Array<Optional<bool>> phaseResults;  // フェーズごとのゴール確認結果（MultiPhaseQuery用）
+};
+
 class IQuery {
 public:
 	virtual ~IQuery() = default;
-	virtual void startSimulation(Stage& stage) = 0;
-	virtual void update(Stage& stage, double dt) = 0;  // 時間ベースの更新
-	virtual bool checkSimulationResult(const Stage& stage) = 0;
+	virtual void startSimulation(Stage& stage, QueryRunState& state) const = 0;
+	virtual void update(Stage& stage, QueryRunState& state, double dt) const = 0;  // 時間ベースの更新
+	virtual bool checkSimulationResult(const Stage& stage, const QueryRunState& state) const = 0;
 	
 	// 全てのボールを放出済みかどうか
-	virtual bool hasFinishedReleasing() const = 0;
+	virtual bool hasFinishedReleasing(const QueryRunState& state) const = 0;
+
+	// 時間指定の放出を待っているだけのとき、放出が起きるまでの update 回数（放出する回を含む）
+	// それ以外（停止待ち・フェーズ切り替えなど、ボールの状態で進行が変わる場合）は none
+	// 全ボールが眠っている間の早送りに使う
+	virtual Optional<int32> stepsUntilTimedRelease(const QueryRunState&, double) const { return none; }
 	
 	// 表示用情報取得
 	virtual Array<Optional<StartBallState>> getStartBalls() const = 0;
@@ -122,8 +146,9 @@ public:
 	
 	// クエリパネル描画（クエリカード内の内容を描画）
 	// queryRect: クエリカード全体の矩形
+	// state: 実行中のクエリの進行状態（isActive のときのみ参照）
 	// 戻り値: 描画に使用した高さ（次のクエリの配置に使用）
-	virtual double drawPanelContent(const RectF& queryRect, bool isActive) const = 0;
+	virtual double drawPanelContent(const RectF& queryRect, bool isActive, const QueryRunState& state) const = 0;
 	
 	// クエリパネルの必要な高さを取得
 	virtual double getPanelHeight() const = 0;
@@ -135,17 +160,17 @@ class SampleQuery : public IQuery {
 public:
 	SampleQuery(const Array<Optional<StartBallState>>& startBalls, const Array<Optional<BallKind>>& goalAreaToBeFilled)
 		: m_startBalls(startBalls), m_goalAreaToBeFilled(goalAreaToBeFilled) {}
-	void startSimulation(Stage& stage) override;
-	void update(Stage& stage, double dt) override;  // no-op for SampleQuery
-	bool checkSimulationResult(const Stage& stage) override;
+	void startSimulation(Stage& stage, QueryRunState& state) const override;
+	void update(Stage& stage, QueryRunState& state, double dt) const override;  // no-op for SampleQuery
+	bool checkSimulationResult(const Stage& stage, const QueryRunState& state) const override;
 	
 	// SampleQueryは開始時に全て放出するので常にtrue
-	bool hasFinishedReleasing() const override { return true; }
+	bool hasFinishedReleasing(const QueryRunState&) const override { return true; }
 	
 	Array<Optional<StartBallState>> getStartBalls() const override { return m_startBalls; }
 	Array<Optional<BallKind>> getGoalRequirements() const override { return m_goalAreaToBeFilled; }
 	
-	double drawPanelContent(const RectF& queryRect, bool isActive) const override;
+	double drawPanelContent(const RectF& queryRect, bool isActive, const QueryRunState& state) const override;
 	double getPanelHeight() const override { return 80.0; }  // 75.0 -> 80.0
 };
 
@@ -160,29 +185,25 @@ public:
 		const Array<Optional<BallKind>>& goalAreaToBeFilled
 	);
 
-	void startSimulation(Stage& stage) override;
-	void update(Stage& stage, double dt) override;
-	bool checkSimulationResult(const Stage& stage) override;
+	void startSimulation(Stage& stage, QueryRunState& state) const override;
+	void update(Stage& stage, QueryRunState& state, double dt) const override;
+	bool checkSimulationResult(const Stage& stage, const QueryRunState& state) const override;
 	
 	// 全てのボールを放出済みかどうか
-	bool hasFinishedReleasing() const override;
+	bool hasFinishedReleasing(const QueryRunState& state) const override;
+	Optional<int32> stepsUntilTimedRelease(const QueryRunState& state, double dt) const override;
 	
 	Array<Optional<StartBallState>> getStartBalls() const override;
 	Array<Optional<BallKind>> getGoalRequirements() const override { return m_goalAreaToBeFilled; }
 	
-	double drawPanelContent(const RectF& queryRect, bool isActive) const override;
+	double drawPanelContent(const RectF& queryRect, bool isActive, const QueryRunState& state) const override;
 	double getPanelHeight() const override;
 
 private:
 	Array<DelayedBallRelease> m_releases;  // 放出シーケンス
 	Array<Optional<BallKind>> m_goalAreaToBeFilled;
 	
-	// シミュレーション状態
-	int32 m_nextReleaseIndex = 0;          // 次の放出インデックス
-	double m_timeSinceLastRelease = 0.0;    // 最後の放出からの経過時間
-	bool m_waitingForAllStopped = false;    // 全ボール停止待ちかどうか
-	
-	void releaseBalls(Stage& stage, int32 releaseIndex);
+	void releaseBalls(Stage& stage, int32 releaseIndex) const;
 	bool areAllBallsStopped(const Stage& stage) const;
 };
 
@@ -197,32 +218,24 @@ public:
 
 	explicit MultiPhaseQuery(const Array<Phase>& phases);
 
-	void startSimulation(Stage& stage) override;
-	void update(Stage& stage, double dt) override;
-	bool checkSimulationResult(const Stage& stage) override;
+	void startSimulation(Stage& stage, QueryRunState& state) const override;
+	void update(Stage& stage, QueryRunState& state, double dt) const override;
+	bool checkSimulationResult(const Stage& stage, const QueryRunState& state) const override;
 
-	bool hasFinishedReleasing() const override;
+	bool hasFinishedReleasing(const QueryRunState& state) const override;
+	Optional<int32> stepsUntilTimedRelease(const QueryRunState& state, double dt) const override;
 
 	Array<Optional<StartBallState>> getStartBalls() const override;
 	Array<Optional<BallKind>> getGoalRequirements() const override;
 
-	double drawPanelContent(const RectF& queryRect, bool isActive) const override;
+	double drawPanelContent(const RectF& queryRect, bool isActive, const QueryRunState& state) const override;
 	double getPanelHeight() const override;
 
 private:
 	Array<Phase> m_phases;
 
-	// フェーズ進行状態
-	int32 m_phaseIndex = 0;
-	int32 m_nextReleaseIndex = 0;
-	double m_timeSinceLastRelease = 0.0;
-	bool m_waitingForAllStopped = false;
-
-	// フェーズごとのゴール確認結果
-	Array<Optional<bool>> m_phaseResults;
-
-	void startPhase(Stage& stage, int32 phaseIndex);
-	void releaseBalls(Stage& stage, int32 phaseIndex, int32 releaseIndex);
+	void startPhase(Stage& stage, QueryRunState& state, int32 phaseIndex) const;
+	void releaseBalls(Stage& stage, int32 phaseIndex, int32 releaseIndex) const;
 	bool areAllBallsStopped(const Stage& stage) const;
 	bool checkGoalForPhase(const Stage& stage, int32 phaseIndex) const;
 };
@@ -238,11 +251,12 @@ public:
 		const Array<GoalRequirement>& goalRequirements
 	);
 
-	void startSimulation(Stage& stage) override;
-	void update(Stage& stage, double dt) override;
-	bool checkSimulationResult(const Stage& stage) override;
+	void startSimulation(Stage& stage, QueryRunState& state) const override;
+	void update(Stage& stage, QueryRunState& state, double dt) const override;
+	bool checkSimulationResult(const Stage& stage, const QueryRunState& state) const override;
 	
-	bool hasFinishedReleasing() const override;
+	bool hasFinishedReleasing(const QueryRunState& state) const override;
+	Optional<int32> stepsUntilTimedRelease(const QueryRunState& state, double dt) const override;
 	
 	Array<Optional<StartBallState>> getStartBalls() const override;
 	Array<Optional<BallKind>> getGoalRequirements() const override;
@@ -250,18 +264,13 @@ public:
 	// 複数ボール要件を取得（新規メソッド）
 	const Array<GoalRequirement>& getMultiGoalRequirements() const { return m_goalRequirements; }
 	
-	double drawPanelContent(const RectF& queryRect, bool isActive) const override;
+	double drawPanelContent(const RectF& queryRect, bool isActive, const QueryRunState& state) const override;
 	double getPanelHeight() const override;
 
 private:
 	Array<DelayedBallRelease> m_releases;
 	Array<GoalRequirement> m_goalRequirements;
 	
-	// シミュレーション状態
-	int32 m_nextReleaseIndex = 0;
-	double m_timeSinceLastRelease = 0.0;
-	bool m_waitingForAllStopped = false;
-	
-	void releaseBalls(Stage& stage, int32 releaseIndex);
+	void releaseBalls(Stage& stage, int32 releaseIndex) const;
 	bool areAllBallsStopped(const Stage& stage) const;
 };
@@ -164,7 +164,7 @@ void QueryPanel::draw(const Stage& stage) const
 					FontAsset(U"Regular")(U"✗").drawAt(12, failBg.center, Palette::White);
 				}
 
-				query->drawPanelContent(queryRect, stage.m_currentQueryIndex == i and stage.m_isSimulationRunning);
+				query->drawPanelContent(queryRect, stage.m_currentQueryIndex == i and stage.m_isSimulationRunning, stage.m_queryRunState);
 				currentY += queryHeight;
 			}
 		}
@@ -3,31 +3,12 @@
 
 bool SelectedIDSet::isSelectedPoint(const Stage& stage, int32 pointId) const
 {
-	if (m_ids.contains(SelectedID{ SelectType::Point, pointId })) return true;
-	for (const auto& s : m_ids) {
-		if (s.type == SelectType::Group) {
-			if (stage.m_groups.at(s.id).containsPointRecursive(pointId)) return true;
-		}
-	}
-	return false;
+	return SelectionMask::Test(mask(stage).points, pointId);
 }
 
 bool SelectedIDSet::isSelectedEdge(const Stage& stage, int32 index) const
 {
-	bool hasEdge_0 = m_ids.contains(SelectedID{ SelectType::Point, stage.m_edges[index][0] });
-	bool hasEdge_1 = m_ids.contains(SelectedID{ SelectType::Point, stage.m_edges[index][1] });
-	if (hasEdge_0 && hasEdge_1) return true;
-	for (const auto& s : m_ids) {
-		if (s.type == SelectType::Group) {
-			const auto& edge = stage.m_edges[index];
-			// エッジの両端点がグループに属しているかチェック
-			if (stage.m_groups.at(s.id).containsPointRecursive(edge[0]) ||
-				stage.m_groups.at(s.id).containsPointRecursive(edge[1])) {
-				return true;
-			}
-		}
-	}
-	return false;
+	return SelectionMask::Test(mask(stage).edges, index);
 }
 
 bool SelectedIDSet::isSelectedStartCircle(int32 index) const
@@ -37,13 +18,7 @@ bool SelectedIDSet::isSelectedStartCircle(int32 index) const
 
 bool SelectedIDSet::isSelectedStartCircle(const Stage& stage, int32 index) const
 {
-	if (m_ids.contains(SelectedID{ SelectType::StartCircle, index })) return true;
-	for (const auto& s : m_ids) {
-		if (s.type == SelectType::Group) {
-			if (stage.m_groups.at(s.id).containsStartCircleRecursive(index)) return true;
-		}
-	}
-	return false;
+	return SelectionMask::Test(mask(stage).startCircles, index);
 }
 
 bool SelectedIDSet::isSelectedGoalArea(int32 index) const
@@ -53,24 +28,91 @@ bool SelectedIDSet::isSelectedGoalArea(int32 index) const
 
 bool SelectedIDSet::isSelectedGoalArea(const Stage& stage, int32 index) const
 {
-	if (m_ids.contains(SelectedID{ SelectType::GoalArea, index })) return true;
-	for (const auto& s : m_ids) {
-		if (s.type == SelectType::Group) {
-			if (stage.m_groups.at(s.id).containsGoalAreaRecursive(index)) return true;
-		}
-	}
-	return false;
+	return SelectionMask::Test(mask(stage).goalAreas, index);
 }
 
 bool SelectedIDSet::isSelectedPlacedBall(const Stage& stage, int32 index) const
 {
-	if (m_ids.contains(SelectedID{ SelectType::PlacedBall, index })) return true;
+	return SelectionMask::Test(mask(stage).placedBalls, index);
+}
+
+const SelectionMask& SelectedIDSet::mask(const Stage& stage) const
+{
+	// m_ids を直接書き換えられた場合やステージ側の増減も拾えるよう、数もキーに含める
+	const MaskKey key{
+		.stage = &stage,
+		.version = m_version,
+		.selectedCount = static_cast<int32>(m_ids.size()),
+		.pointSlotCount = stage.m_points.slotCount(),
+		.edgeCount = stage.m_edges.slotCount(),
+		.pointsVersion = stage.m_points.version(),
+		.edgesVersion = stage.m_edges.version(),
+		.placedBallsVersion = stage.m_placedBalls.version(),
+		.groupCount = static_cast<int32>(stage.m_groups.size()),
+		.startCircleCount = static_cast<int32>(stage.m_startCircles.size()),
+		.goalAreaCount = static_cast<int32>(stage.m_goalAreas.size()),
+		.placedBallCount = stage.m_placedBalls.slotCount(),
+	};
+	if (m_maskKey == key) {
+		return m_mask;
+	}
+
+	SelectionMask& m = m_mask;
+	m.points.assign(key.pointSlotCount, false);
+	m.edges.assign(key.edgeCount, false);
+	m.startCircles.assign(key.startCircleCount, false);
+	m.goalAreas.assign(key.goalAreaCount, false);
+	m.placedBalls.assign(key.placedBallCount, false);
+	m.hasGroup = false;
+	m.pointCount = 0;
+
+	auto set = [](Array<bool>& bits, int32 index) {
+		if (0 <= index && index < bits.size()) bits[index] = true;
+	};
+
+	// 選択グループの中身（点はエッジ判定用に別に持つ）
+	Array<bool> groupPoints(key.pointSlotCount, false);
+
 	for (const auto& s : m_ids) {
-		if (s.type == SelectType::Group) {
-			if (stage.m_groups.at(s.id).containsPlacedBallRecursive(index)) return true;
+		switch (s.type) {
+		case SelectType::Point:
+			set(m.points, s.id);
+			++m.pointCount;
+			break;
+		case SelectType::Group: {
+			const auto members = stage.groupMembers(s.id);
+			for (auto id : members.pointIds) set(groupPoints, id);
+			for (auto id : members.startCircleIds) set(m.startCircles, id);
+			for (auto id : members.goalAreaIds) set(m.goalAreas, id);
+			for (auto id : members.placedBallIds) set(m.placedBalls, id);
+			m.hasGroup = true;
+			break;
+		}
+		case SelectType::StartCircle:
+			set(m.startCircles, s.id);
+			break;
+		case SelectType::GoalArea:
+			set(m.goalAreas, s.id);
+			break;
+		case SelectType::PlacedBall:
+			set(m.placedBalls, s.id);
+			break;
 		}
 	}
-	return false;
+
+	// エッジは両端が直接選択されているか、どちらかの端が選択グループに含まれていれば選択扱い
+	for (const auto& [edgeId, edge] : stage.m_edges) {
+		const bool byPoints = SelectionMask::Test(m.points, edge[0]) && SelectionMask::Test(m.points, edge[1]);
+		const bool byGroup = SelectionMask::Test(groupPoints, edge[0]) || SelectionMask::Test(groupPoints, edge[1]);
+		m.edges[edgeId] = byPoints || byGroup;
+	}
+
+	for (int32 i = 0; i < key.pointSlotCount; ++i) {
+		if (groupPoints[i]) m.points[i] = true;
+	}
+
+	m_maskKey = key;
+	return m_mask;
 }
 
 Optional<Vec2> SelectedIDSet::getBeginPointOfSelectedObjects(const Stage& stage) const
@@ -115,27 +157,23 @@ Vec2 SelectedIDSet::getBottomRightOfSelectedObjects(const Stage& stage) const
 			maxY = Max(maxY, pos.y);
 		}
 		else if (s.type == SelectType::Group) {
-			const auto& group = stage.m_groups.at(s.id);
-			auto allPointIds = group.getAllPointIds();
-			for (auto pointId : allPointIds) {
+			const auto group = stage.groupMembers(s.id);
+			for (auto pointId : group.pointIds) {
 				const Vec2& pos = stage.m_points.at(pointId);
 				maxX = Max(maxX, pos.x);
 				maxY = Max(maxY, pos.y);
 			}
-			auto allPlacedBallIds = group.getAllPlacedBallIds();
-			for (auto ballId : allPlacedBallIds) {
+			for (auto ballId : group.placedBallIds) {
 				const auto& ball = stage.m_placedBalls[ballId];
 				maxX = Max(maxX, ball.center.x + GetBallRadius(ball.kind));
 				maxY = Max(maxY, ball.center.y + GetBallRadius(ball.kind));
 			}
-			auto allStartCircleIds = group.getAllStartCircleIds();
-			for (auto scId : allStartCircleIds) {
+			for (auto scId : group.startCircleIds) {
 				const auto& sc = stage.m_startCircles[scId];
 				maxX = Max(maxX, sc.circle.center.x + sc.circle.r);
 				maxY = Max(maxY, sc.circle.center.y + sc.circle.r);
 			}
-			auto allGoalAreaIds = group.getAllGoalAreaIds();
-			for (auto gaId : allGoalAreaIds) {
+			for (auto gaId : group.goalAreaIds) {
 				const auto& ga = stage.m_goalAreas[gaId];
 				maxX = Max(maxX, ga.rect.br().x);
 				maxY = Max(maxY, ga.rect.br().y);
@@ -178,7 +216,7 @@ bool SelectedIDSet::isMovedSelectedNotInNonEditableArea(const Stage& stage, cons
 			movedPointIds.insert(s.id);
 		}
 		else if (s.type == SelectType::Group) {
-			movedPointIds.merge(stage.m_groups.at(s.id).getAllPointIds());
+			for (auto pid : stage.groupMembers(s.id).pointIds) movedPointIds.insert(pid);
 		}
 	}
 
@@ -190,22 +228,26 @@ bool SelectedIDSet::isMovedSelectedNotInNonEditableArea(const Stage& stage, cons
 		}
 	}
 
-	// Any edge incident to a moved point must remain allowed
-	if (!movedPointIds.empty()) {
-		for (const auto& e : stage.m_edges) {
+	// Any edge incident to a moved point must remain allowed (tested as one batch)
+	Array<Line> movedLines;
+	for (auto pid : movedPointIds) {
+		for (auto edgeIndex : stage.incidentEdges(pid)) {
+			const auto& e = stage.m_edges[edgeIndex];
 			if (e.isLocked) continue;
 
 			const bool end0Moved = movedPointIds.contains(e[0]);
 			const bool end1Moved = movedPointIds.contains(e[1]);
-			if (!(end0Moved || end1Moved)) continue;
+			// Both ends moved: check it only once, from e[0]
+			if (end0Moved && end1Moved && pid != e[0]) continue;
 
 			const Vec2 p0 = stage.m_points.at(e[0]) + (end0Moved ? delta : Vec2{ 0, 0 });
 			const Vec2 p1 = stage.m_points.at(e[1]) + (end1Moved ? delta : Vec2{ 0, 0 });
-			if (!stage.isLineAllowedInEditableArea(Line{ p0, p1 })) {
-				return false;
-			}
+			movedLines.emplace_back(p0, p1);
 		}
 	}
+	if (!stage.areLinesAllowedInEditableArea(movedLines)) {
+		return false;
+	}
 
 	// Other selected objects must not move their anchors into forbidden area
 	for (const auto& s : m_ids) {
@@ -226,17 +268,17 @@ bool SelectedIDSet::isMovedSelectedNotInNonEditableArea(const Stage& stage, cons
 	// Group members for non-point objects
 	for (const auto& s : m_ids) {
 		if (s.type != SelectType::Group) continue;
-		const auto& g = stage.m_groups.at(s.id);
+		const auto g = stage.groupMembers(s.id);
 
-		for (auto sid : g.getAllStartCircleIds()) {
+		for (auto sid : g.startCircleIds) {
 			const Vec2 newCenter = stage.m_startCircles[sid].circle.center + delta;
 			if (stage.isPointInNonEditableArea(newCenter)) return false;
 		}
-		for (auto gid : g.getAllGoalAreaIds()) {
+		for (auto gid : g.goalAreaIds) {
 			const Vec2 newPos = stage.m_goalAreas[gid].rect.pos + delta;
 			if (stage.isPointInNonEditableArea(newPos)) return false;
 		}
-		for (auto bid : g.getAllPlacedBallIds()) {
+		for (auto bid : g.placedBallIds) {
 			const Vec2 newCenter = stage.m_placedBalls[bid].center + delta;
 			if (stage.isPointInNonEditableArea(newCenter)) return false;
 		}
@@ -253,21 +295,17 @@ void SelectedIDSet::moveSelectedObjects(Stage& stage, const Vec2& delta) const
 			stage.m_points.at(s.id) += delta;
 			break;
 		case SelectType::Group: {
-			auto& group = stage.m_groups.at(s.id);
-			auto pointIds = group.getAllPointIds();
-			for (auto pid : pointIds) {
+			const auto group = stage.groupMembers(s.id);
+			for (auto pid : group.pointIds) {
 				stage.m_points.at(pid) += delta;
 			}
-			auto startCircleIds = group.getAllStartCircleIds();
-			for (auto cid : startCircleIds) {
+			for (auto cid : group.startCircleIds) {
 				stage.m_startCircles[cid].circle.center += delta;
 			}
-			auto goalAreaIds = group.getAllGoalAreaIds();
-			for (auto gid : goalAreaIds) {
+			for (auto gid : group.goalAreaIds) {
 				stage.m_goalAreas[gid].rect.pos += delta;
 			}
-			auto placedBallIds = group.getAllPlacedBallIds();
-			for (auto bid : placedBallIds) {
+			for (auto bid : group.placedBallIds) {
 				stage.m_placedBalls[bid].center += delta;
 			}
 			break;
@@ -283,6 +321,8 @@ void SelectedIDSet::moveSelectedObjects(Stage& stage, const Vec2& delta) const
 			break;
 		}
 	}
+	stage.invalidateSpatialCaches();
+	stage.invalidateScoreCounters();
 }
 
 bool SelectedIDSet::flipHorizontalSelectedObjects(Stage& stage) const
@@ -302,20 +342,20 @@ bool SelectedIDSet::flipHorizontalSelectedObjects(Stage& stage) const
 			expandX(stage.m_points.at(s.id).x);
 			break;
 		case SelectType::Group: {
-			const auto& group = stage.m_groups.at(s.id);
-			for (auto pid : group.getAllPointIds())
+			const auto group = stage.groupMembers(s.id);
+			for (auto pid : group.pointIds)
 				expandX(stage.m_points.at(pid).x);
-			for (auto bid : group.getAllPlacedBallIds()) {
+			for (auto bid : group.placedBallIds) {
 				const auto& ball = stage.m_placedBalls[bid];
 				expandX(ball.center.x - GetBallRadius(ball.kind));
 				expandX(ball.center.x + GetBallRadius(ball.kind));
 			}
-			for (auto cid : group.getAllStartCircleIds()) {
+			for (auto cid : group.startCircleIds) {
 				const auto& sc = stage.m_startCircles[cid];
 				expandX(sc.circle.center.x - sc.circle.r);
 				expandX(sc.circle.center.x + sc.circle.r);
 			}
-			for (auto gid : group.getAllGoalAreaIds()) {
+			for (auto gid : group.goalAreaIds) {
 				const auto& ga = stage.m_goalAreas[gid];
 				expandX(ga.rect.x);
 				expandX(ga.rect.x + ga.rect.w);
@@ -354,7 +394,9 @@ bool SelectedIDSet::flipHorizontalSelectedObjects(Stage& stage) const
 		HashSet<int32> movedPointIds;
 		for (const auto& s : m_ids) {
 			if (s.type == SelectType::Point) movedPointIds.insert(s.id);
-			else if (s.type == SelectType::Group) movedPointIds.merge(stage.m_groups.at(s.id).getAllPointIds());
+			else if (s.type == SelectType::Group) {
+				for (auto pid : stage.groupMembers(s.id).pointIds) movedPointIds.insert(pid);
+			}
 		}
 
 		// Check flipped point positions
@@ -364,19 +406,22 @@ bool SelectedIDSet::flipHorizontalSelectedObjects(Stage& stage) const
 		}
 
 		// Check edges incident to moved points
-		if (!movedPointIds.empty()) {
-			for (const auto& e : stage.m_edges) {
+		Array<Line> flippedLines;
+		for (auto pid : movedPointIds) {
+			for (auto edgeIndex : stage.incidentEdges(pid)) {
+				const auto& e = stage.m_edges[edgeIndex];
 				if (e.isLocked) continue;
 				const bool end0Moved = movedPointIds.contains(e[0]);
 				const bool end1Moved = movedPointIds.contains(e[1]);
-				if (!(end0Moved || end1Moved)) continue;
+				if (end0Moved && end1Moved && pid != e[0]) continue;
 				const Vec2& pos0 = stage.m_points.at(e[0]);
 				const Vec2& pos1 = stage.m_points.at(e[1]);
 				Vec2 p0 = end0Moved ? Vec2{ flipX(pos0.x), pos0.y } : pos0;
 				Vec2 p1 = end1Moved ? Vec2{ flipX(pos1.x), pos1.y } : pos1;
-				if (!stage.isLineAllowedInEditableArea(Line{ p0, p1 })) return false;
+				flippedLines.emplace_back(p0, p1);
 			}
 		}
+		if (!stage.areLinesAllowedInEditableArea(flippedLines)) return false;
 
 		// Check other selected objects
 		for (const auto& s : m_ids) {
@@ -397,16 +442,16 @@ bool SelectedIDSet::flipHorizontalSelectedObjects(Stage& stage) const
 		// Check group non-point members
 		for (const auto& s : m_ids) {
 			if (s.type != SelectType::Group) continue;
-			const auto& g = stage.m_groups.at(s.id);
-			for (auto cid : g.getAllStartCircleIds()) {
+			const auto g = stage.groupMembers(s.id);
+			for (auto cid : g.startCircleIds) {
 				const Vec2& c = stage.m_startCircles[cid].circle.center;
 				if (stage.isPointInNonEditableArea({ flipX(c.x), c.y })) return false;
 			}
-			for (auto gid : g.getAllGoalAreaIds()) {
+			for (auto gid : g.goalAreaIds) {
 				const auto& ga = stage.m_goalAreas[gid];
 				if (stage.isPointInNonEditableArea({ flipX(ga.rect.x + ga.rect.w), ga.rect.y })) return false;
 			}
-			for (auto bid : g.getAllPlacedBallIds()) {
+			for (auto bid : g.placedBallIds) {
 				const Vec2& c = stage.m_placedBalls[bid].center;
 				if (stage.isPointInNonEditableArea({ flipX(c.x), c.y })) return false;
 			}
@@ -420,14 +465,14 @@ bool SelectedIDSet::flipHorizontalSelectedObjects(Stage& stage) const
 			stage.m_points.at(s.id).x = flipX(stage.m_points.at(s.id).x);
 			break;
 		case SelectType::Group: {
-			const auto& group = stage.m_groups.at(s.id);
-			for (auto pid : group.getAllPointIds())
+			const auto group = stage.groupMembers(s.id);
+			for (auto pid : group.pointIds)
 				stage.m_points.at(pid).x = flipX(stage.m_points.at(pid).x);
-			for (auto bid : group.getAllPlacedBallIds())
+			for (auto bid : group.placedBallIds)
 				stage.m_placedBalls[bid].center.x = flipX(stage.m_placedBalls[bid].center.x);
-			for (auto cid : group.getAllStartCircleIds())
+			for (auto cid : group.startCircleIds)
 				stage.m_startCircles[cid].circle.center.x = flipX(stage.m_startCircles[cid].circle.center.x);
-			for (auto gid : group.getAllGoalAreaIds()) {
+			for (auto gid : group.goalAreaIds) {
 				auto& ga = stage.m_goalAreas[gid];
 				ga.rect.x = flipX(ga.rect.x + ga.rect.w);
 			}
@@ -446,6 +491,8 @@ bool SelectedIDSet::flipHorizontalSelectedObjects(Stage& stage) const
 			break;
 		}
 	}
+	stage.invalidateSpatialCaches();
+	stage.invalidateScoreCounters();
 	return true;
 }
 
@@ -455,7 +502,7 @@ void SelectedIDSet::selectAllObjects(const Stage& stage)
 
 	// ロックされている対象は Ctrl+A の対象外
 	HashSet<int32> lockedPointIds;
-	for (const auto& e : stage.m_edges) {
+	for (const auto& [edgeId, e] : stage.m_edges) {
 		if (e.isLocked) {
 			lockedPointIds.insert(e[0]);
 			lockedPointIds.insert(e[1]);
@@ -482,11 +529,12 @@ void SelectedIDSet::selectAllObjects(const Stage& stage)
 			m_ids.insert(SelectedID{ SelectType::GoalArea, i });
 		}
 	}
-	for (int32 i = 0; i < stage.m_placedBalls.size(); ++i) {
-		if (!stage.m_placedBalls[i].isLocked) {
-			m_ids.insert(SelectedID{ SelectType::PlacedBall, i });
+	for (const auto& [ballId, ball] : stage.m_placedBalls) {
+		if (!ball.isLocked) {
+			m_ids.insert(SelectedID{ SelectType::PlacedBall, ballId });
 		}
 	}
+	touch();
 }
 
 void SelectedIDSet::selectObjectsByPoints(const Stage& stage, const HashSet<int32>& pointIds)
@@ -497,14 +545,14 @@ void SelectedIDSet::selectObjectsByPoints(const Stage& stage, const HashSet<int3
 		else m_ids.insert(SelectedID{ SelectType::Point, pointId });
 	}
 	for (const auto& groupId : group_candidates) {
-		const auto& group = stage.m_groups.at(groupId);
+		const auto group = stage.groupMembers(groupId);
 		bool allMembersSelected = true;
-		auto allPointIdsInGroup = group.getAllPointIds();
-		for (auto& memberId : allPointIdsInGroup) {
+		for (auto& memberId : group.pointIds) {
 			if (not pointIds.contains(memberId)) { allMembersSelected = false; break; }
 		}
 		if (allMembersSelected) m_ids.insert(SelectedID{ SelectType::Group, groupId });
 	}
+	touch();
 }
 
 void SelectedIDSet::selectPlacedBallsByIds(const Stage& stage, const HashSet<int32>& ballIds)
@@ -515,14 +563,14 @@ void SelectedIDSet::selectPlacedBallsByIds(const Stage& stage, const HashSet<int
 		else m_ids.insert(SelectedID{ SelectType::PlacedBall, ballId });
 	}
 	for (const auto& groupId : group_candidates) {
-		const auto& group = stage.m_groups.at(groupId);
+		const auto group = stage.groupMembers(groupId);
 		bool allMembersSelected = true;
-		auto allBallIdsInGroup = group.getAllPlacedBallIds();
-		for (auto& memberId : allBallIdsInGroup) {
+		for (auto& memberId : group.placedBallIds) {
 			if (not ballIds.contains(memberId)) { allMembersSelected = false; break; }
 		}
 		if (allMembersSelected) m_ids.insert(SelectedID{ SelectType::Group, groupId });
 	}
+	touch();
 }
 
 void SelectedIDSet::selectObjectsInArea(const Stage& stage, const RectF& area)
@@ -533,87 +581,26 @@ void SelectedIDSet::selectObjectsInArea(const Stage& stage, const RectF& area)
 	Array<int32> areaPlacedBallIds;
 	HashSet<int32> group_candidates;
 
-	for (const auto& edge : stage.m_edges) {
-		if (edge.isLocked) continue;
-		for (auto pid : edge.ids) {
-			if (area.intersects(stage.m_points.at(pid))) {
-				if (auto topGroupId = stage.findTopGroup(pid)) group_candidates.insert(*topGroupId);
-				else areaPointIds.push_back(pid);
-			}
-		}
-	}
-	for (int32 i = 0; i < stage.m_startCircles.size(); ++i) {
-		if (stage.m_startCircles[i].isLocked) continue;
-		if (area.intersects(stage.m_startCircles[i].circle.center)) {
-			// グループに属している場合はグループ候補に追加
-			if (auto topGroupId = stage.findTopGroupForStartCircle(i)) {
-				group_candidates.insert(*topGroupId);
-			}
-			else {
-				areaStartCircleIds.push_back(i);
-			}
+	// 矩形に入るロックされていないオブジェクトを索引から引く（グループに属していればグループ候補にする）
+	const auto& index = stage.areaSelectIndex();
+	index.forEachIn(area, [&](const AreaSelectIndex::Anchor& anchor) {
+		if (anchor.topGroupId != -1) {
+			group_candidates.insert(anchor.topGroupId);
+			return;
 		}
-	}
-	for (int32 i = 0; i < stage.m_goalAreas.size(); ++i) {
-		if (stage.m_goalAreas[i].isLocked) continue;
-		if (area.intersects(stage.m_goalAreas[i].rect.center())) {
-			// グループに属している場合はグループ候補に追加
-			if (auto topGroupId = stage.findTopGroupForGoalArea(i)) {
-				group_candidates.insert(*topGroupId);
-			}
-			else {
-				areaGoalAreaIds.push_back(i);
-			}
-		}
-	}
-	for (int32 i = 0; i < stage.m_placedBalls.size(); ++i) {
-		if (stage.m_placedBalls[i].isLocked) continue;
-		if (area.intersects(stage.m_placedBalls[i].center)) {
-			// グループに属している場合はグループ候補に追加
-			if (auto topGroupId = stage.findTopGroupForPlacedBall(i)) {
-				group_candidates.insert(*topGroupId);
-			}
-			else {
-				areaPlacedBallIds.push_back(i);
-			}
+		switch (anchor.type) {
+		case SelectType::Point: areaPointIds.push_back(anchor.id); break;
+		case SelectType::StartCircle: areaStartCircleIds.push_back(anchor.id); break;
+		case SelectType::GoalArea: areaGoalAreaIds.push_back(anchor.id); break;
+		case SelectType::PlacedBall: areaPlacedBallIds.push_back(anchor.id); break;
+		default: break;
 		}
-	}
+	});
+
+	// グループはメンバー全体の外接矩形が矩形に収まっていれば選ぶ
 	Array<int32> areaGroupIds;
 	for (const auto& groupId : group_candidates) {
-		const auto& group = stage.m_groups.at(groupId);
-		bool allMembersInArea = true;
-		
-		// ポイントのチェック
-		auto allPointIdsInGroup = group.getAllPointIds();
-		for (auto& memberId : allPointIdsInGroup) {
-			if (not area.contains(stage.m_points.at(memberId))) { allMembersInArea = false; break; }
-		}
-		
-		// StartCircle のチェック
-		if (allMembersInArea) {
-			auto allStartCircleIdsInGroup = group.getAllStartCircleIds();
-			for (auto& memberId : allStartCircleIdsInGroup) {
-				if (not area.contains(stage.m_startCircles[memberId].circle.center)) { allMembersInArea = false; break; }
-			}
-		}
-		
-		// GoalArea のチェック
-		if (allMembersInArea) {
-			auto allGoalAreaIdsInGroup = group.getAllGoalAreaIds();
-			for (auto& memberId : allGoalAreaIdsInGroup) {
-				if (not area.contains(stage.m_goalAreas[memberId].rect.center())) { allMembersInArea = false; break; }
-			}
-		}
-		
-		// PlacedBall のチェック
-		if (allMembersInArea) {
-			auto allPlacedBallIdsInGroup = group.getAllPlacedBallIds();
-			for (auto& memberId : allPlacedBallIdsInGroup) {
-				if (not area.contains(stage.m_placedBalls[memberId].center)) { allMembersInArea = false; break; }
-			}
-		}
-		
-		if (allMembersInArea) areaGroupIds.push_back(groupId);
+		if (index.containsGroup(area, groupId)) areaGroupIds.push_back(groupId);
 	}
 	if (KeyShift.pressed()) {
 		bool allSelected = true;
@@ -645,4 +632,5 @@ void SelectedIDSet::selectObjectsInArea(const Stage& stage, const RectF& area)
 		for (auto& id : areaGoalAreaIds) m_ids.insert(SelectedID{ SelectType::GoalArea, id });
 		for (auto& id : areaPlacedBallIds) m_ids.insert(SelectedID{ SelectType::PlacedBall, id });
 	}
+	touch();
 }
@@ -0,0 +1,317 @@
+﻿# include "SimulationEngine.hpp"
+
+Optional<bool> SimulationEngine::pollVerdict()
+{
+	if (not m_stage.m_isSimulationRunning || m_stage.m_isSimulationPaused) {
+		return none;
+	}
+
+	return checkVerdict();
+}
+
+void SimulationEngine::step(int32 n)
+{
+	for (int32 i = 0; i < n; ++i) {
+		m_stage.m_world.update(Stage::simulationTimeStep);
+
+		// ゴール侵入判定：ゴールに入ってからの経過時間を更新
+		updateGoalDwell();
+
+		// クエリの時間ベース更新（SequentialQuery用）
+		if (m_stage.m_currentQueryIndex < m_stage.m_queries->size()) {
+			(*m_stage.m_queries)[m_stage.m_currentQueryIndex]->update(m_stage, m_stage.m_queryRunState, Stage::simulationTimeStep);
+		}
+
+		// 放出されたボールをゴール判定に登録
+		registerNewBalls();
+
+		// 遅すぎる場合は強制終了
+		stopSlowBalls();
+
+		++m_stage.m_simulationStepCount;
+
+		m_stage.recordTrajectory();
+	}
+}
+
+int32 SimulationEngine::skipIdleSteps(int32 maxSteps)
+{
+	if (maxSteps <= 0 || m_stage.m_currentQueryIndex >= m_stage.m_queries->size() || not isAllBallsAsleep()) {
+		return 0;
+	}
+
+	const auto& query = (*m_stage.m_queries)[m_stage.m_currentQueryIndex];
+	const auto stepsUntilRelease = query->stepsUntilTimedRelease(m_stage.m_queryRunState, Stage::simulationTimeStep);
+	if (not stepsUntilRelease) {
+		return 0;
+	}
+
+	// 放出するステップは通常どおり進める
+	const int32 n = Min(*stepsUntilRelease - 1, maxSteps);
+	for (int32 i = 0; i < n; ++i) {
+		// ボールは動かないので、ゴール内にいるボールの経過時間だけを進める
+		for (auto& b : m_stage.m_startBallsInWorld) {
+			if (b.timeSinceEnteredGoal) {
+				*b.timeSinceEnteredGoal += Stage::simulationTimeStep;
+			}
+		}
+
+		query->update(m_stage, m_stage.m_queryRunState, Stage::simulationTimeStep);
+		registerNewBalls();
+
+		++m_stage.m_simulationStepCount;
+
+		m_stage.recordTrajectory();
+	}
+	return Max(n, 0);
+}
+
+int32 SimulationEngine::advance(double dt)
+{
+	if (not m_stage.m_isSimulationRunning || m_stage.m_isSimulationPaused) {
+		return 0;
+	}
+
+	int32 steps = 0;
+	// 速度倍率を適用
+	for (m_stage.m_simulationTimeAccumlate += dt * m_stage.m_simulationSpeed; m_stage.m_simulationTimeAccumlate >= Stage::simulationTimeStep; m_stage.m_simulationTimeAccumlate -= Stage::simulationTimeStep) {
+		step();
+		++steps;
+	}
+	return steps;
+}
+
+Optional<bool> SimulationEngine::advanceWithinBudget(double budgetMs)
+{
+	if (not m_stage.m_isSimulationRunning || m_stage.m_isSimulationPaused) {
+		return none;
+	}
+
+	const Stopwatch stopwatch{ StartImmediately::Yes };
+	while (true) {
+		if (const auto verdict = checkVerdict()) {
+			return verdict;
+		}
+		if (skipIdleSteps(DefaultMaxSteps) == 0) {
+			step();
+		}
+		if (stopwatch.msF() >= budgetMs) {
+			return none;
+		}
+	}
+}
+
+SimulationEngine::QueryResult SimulationEngine::runToVerdict(int32 maxSteps)
+{
+	QueryResult result;
+	result.queryIndex = m_stage.m_currentQueryIndex;
+
+	// フレームループと同じく「判定 → ステップ」の順で進める
+	while (true) {
+		if (const auto verdict = checkVerdict()) {
+			result.isSuccess = *verdict;
+			break;
+		}
+		if (m_stage.m_simulationStepCount >= maxSteps) {
+			result.isTimedOut = true;
+			break;
+		}
+		if (skipIdleSteps(maxSteps - m_stage.m_simulationStepCount) == 0) {
+			step();
+		}
+	}
+
+	result.steps = m_stage.m_simulationStepCount;
+	return result;
+}
+
+Array<SimulationEngine::QueryResult> SimulationEngine::runAllQueries(int32 maxStepsPerQuery)
+{
+	Array<QueryResult> results;
+
+	if (m_stage.m_isSimulationRunning) {
+		m_stage.endSimulation();
+	}
+	m_stage.resetQueryProgress();
+
+	for (int32 i = 0; i < m_stage.m_queries->size(); ++i) {
+		m_stage.m_currentQueryIndex = i;
+		m_stage.startSimulation();
+
+		const QueryResult result = runToVerdict(maxStepsPerQuery);
+		if (result.isSuccess) {
+			m_stage.markQueryCompleted(i);
+		}
+		else {
+			m_stage.markQueryFailed(i);
+		}
+		m_stage.endSimulation();
+
+		results.push_back(result);
+	}
+
+	m_stage.m_currentQueryIndex = 0;
+	return results;
+}
+
+Stage SimulationEngine::CreateVerificationStage(const Stage& stage, int32 queryIndex)
+{
+	Stage clone;
+	clone.m_name = stage.m_name;
+	clone.m_points = stage.m_points;
+	clone.m_edges = stage.m_edges;
+	clone.m_startCircles = stage.m_startCircles;
+	clone.m_goalAreas = stage.m_goalAreas;
+	clone.m_placedBalls = stage.m_placedBalls;
+	clone.m_nonEditableAreas = stage.m_nonEditableAreas;
+	clone.m_inventorySlots = stage.m_inventorySlots;
+	clone.m_queries = stage.m_queries;
+	clone.m_mergeConnectedLines = stage.m_mergeConnectedLines;
+	clone.m_isTrajectoryRecordingEnabled = false;  // 検証結果だけが必要なので記録しない
+
+	// 初期状態から始めることで、複製側のエッジ・ボールから初期配置を組み立てさせる
+	clone.resetQueryProgress();
+	clone.m_currentQueryIndex = queryIndex;
+	return clone;
+}
+
+AsyncTask<Array<SimulationEngine::QueryResult>> SimulationEngine::VerifyAllQueriesAsync(const Stage& stage, int32 maxStepsPerQuery)
+{
+	auto stages = std::make_shared<Array<Stage>>();
+	for (int32 i = 0; i < stage.m_queries->size(); ++i) {
+		stages->push_back(CreateVerificationStage(stage, i));
+	}
+
+	return Async([stages, maxStepsPerQuery]() {
+		Array<QueryResult> results(stages->size(), QueryResult{});
+		if (stages->isEmpty()) {
+			return results;
+		}
+
+		// 空いたワーカーが次のクエリを取りに行く
+		std::atomic<size_t> nextIndex{ 0 };
+		auto worker = [&]() {
+			for (size_t i = nextIndex++; i < stages->size(); i = nextIndex++) {
+				Stage& s = (*stages)[i];
+				s.startSimulation();
+				results[i] = SimulationEngine{ s }.runToVerdict(maxStepsPerQuery);
+				s.endSimulation();
+			}
+		};
+
+		const size_t workerCount = Clamp<size_t>(Threading::GetConcurrency(), 1, stages->size());
+		Array<AsyncTask<void>> workers;
+		for (size_t i = 1; i < workerCount; ++i) {
+			workers.push_back(Async(worker));
+		}
+		worker();
+		for (auto& w : workers) {
+			w.wait();
+		}
+
+		return results;
+	});
+}
+
+Optional<bool> SimulationEngine::checkVerdict()
+{
+	removeFallenBalls();
+
+	// 終了判定: 全てのボールが (静止 OR ゴール侵入後1秒経過) AND クエリが全てのボールを放出済み
+	if (not isAllBallsFinished()) {
+		return none;
+	}
+
+	// クエリが全てのボールを放出済みかチェック
+	if (m_stage.m_currentQueryIndex < m_stage.m_queries->size()) {
+		if (not (*m_stage.m_queries)[m_stage.m_currentQueryIndex]->hasFinishedReleasing(m_stage.m_queryRunState)) {
+			return none;
+		}
+	}
+
+	return m_stage.checkSimulationResult();
+}
+
+void SimulationEngine::removeFallenBalls()
+{
+	const double fallThreshold = m_stage.getLowestY() + 100;
+	for (auto& c : m_stage.m_startBallsInWorld) {
+		if (c.body.getPos().y > fallThreshold) {
+			m_stage.m_goalAreaIndex.removeBall(c);
+			c.body.release();
+		}
+	}
+	m_stage.m_startBallsInWorld.remove_if([](const auto& c) { return c.body.isEmpty(); });
+}
+
+bool SimulationEngine::isAllBallsFinished() const
+{
+	for (const auto& c : m_stage.m_startBallsInWorld) {
+		if (c.body.isEmpty()) {
+			continue;
+		}
+
+		const bool finishedBySleep = (not c.body.isAwake());
+		const bool finishedByGoal = (c.timeSinceEnteredGoal && (*c.timeSinceEnteredGoal >= 1.0));
+		if (not (finishedBySleep || finishedByGoal)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SimulationEngine::isAllBallsAsleep() const
+{
+	for (const auto& c : m_stage.m_startBallsInWorld) {
+		if (not c.body.isEmpty() && c.body.isAwake()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void SimulationEngine::updateGoalDwell()
+{
+	for (auto& b : m_stage.m_startBallsInWorld) {
+		if (b.body.isEmpty()) {
+			b.timeSinceEnteredGoal = none;
+			continue;
+		}
+
+		m_stage.m_goalAreaIndex.updateBall(b);
+		const bool inGoal = not b.goalIndices.empty();
+
+		if (inGoal) {
+			if (b.timeSinceEnteredGoal) {
+				*b.timeSinceEnteredGoal += Stage::simulationTimeStep;
+			}
+			else {
+				b.timeSinceEnteredGoal = 0.0;
+			}
+		}
+		else {
+			b.timeSinceEnteredGoal = none;
+		}
+	}
+}
+
+void SimulationEngine::registerNewBalls()
+{
+	for (auto& b : m_stage.m_startBallsInWorld) {
+		if (not b.isRegisteredInGoals) {
+			m_stage.m_goalAreaIndex.updateBall(b);
+		}
+	}
+}
+
+void SimulationEngine::stopSlowBalls()
+{
+	for (auto& c : m_stage.m_startBallsInWorld) {
+		Vec2 vel = c.body.getVelocity();
+		double angleV = c.body.getAngularVelocity();
+		if (abs(vel.y) < 0.001 and abs(vel.x) < 2 and abs(angleV) < 0.1) {
+			c.body.setVelocity({ 0,0 });
+			c.body.setAngularVelocity(0);
+		}
+	}
+}
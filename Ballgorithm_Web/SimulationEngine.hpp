@@ -0,0 +1,69 @@
+﻿#pragma once
+
+# include <Siv3D.hpp>
+# include "Stage.hpp"
+
+// 描画・入力に依存しないシミュレーション進行
+// StageUI / LeaderboardScene / ヘッドレス検証で同じ固定ステップループを共有する
+class SimulationEngine {
+public:
+	// 1クエリぶんの判定結果
+	struct QueryResult {
+		int32 queryIndex = 0;
+		bool isSuccess = false;
+		bool isTimedOut = false;  // ステップ上限に達して打ち切った
+		int32 steps = 0;
+	};
+
+	// runToVerdict のステップ上限（シミュレーション時間で10分）
+	static constexpr int32 DefaultMaxSteps = 60 * 60 * 10;
+
+	explicit SimulationEngine(Stage& stage) : m_stage(stage) {}
+
+	// 落下したボールを除去し、終了判定を行う
+	// 判定が出たら成否を返す（markQuery* / endSimulation は呼び出し側で行う）
+	// 停止中・一時停止中は none
+	Optional<bool> pollVerdict();
+
+	// 判定が出るか、実時間で budgetMs を使い切るまで固定ステップを進める（Instant モード用）
+	// 1フレームに1回呼ぶ想定で、少なくとも1ステップは進める。判定が出たら成否を返す
+	Optional<bool> advanceWithinBudget(double budgetMs);
+
+	// 固定ステップを n 回進める
+	void step(int32 n = 1);
+
+	// 全ボールが眠っていて、クエリが時間指定の放出を待っているだけなら、
+	// 物理演算を省いて放出の直前（最大 maxSteps）までステップを進める。進めたステップ数を返す
+	// 眠っているボールは動かず判定も変わらないので、1ステップずつ進めた場合と同じ結果になる
+	int32 skipIdleSteps(int32 maxSteps);
+
+	// dt × 速度倍率を蓄積し、溜まった分だけ固定ステップを進める。進めたステップ数を返す
+	int32 advance(double dt);
+
+	// startSimulation 済みのステージを判定が出るまで進める
+	// maxSteps を超えたら失敗扱い
+	QueryResult runToVerdict(int32 maxSteps = DefaultMaxSteps);
+
+	// 全クエリを先頭から順に検証し、結果を markQueryCompleted / markQueryFailed に反映する
+	Array<QueryResult> runAllQueries(int32 maxStepsPerQuery = DefaultMaxSteps);
+
+	// 指定クエリだけを検証するためのステージ複製（物理ワールド・ボールは共有しない）
+	static Stage CreateVerificationStage(const Stage& stage, int32 queryIndex);
+
+	// 全クエリをクエリごとに独立したワールドで並列に検証する（ワーカー数はコア数まで）
+	// 複製は呼び出しスレッドで作るので、タスク実行中に元のステージを編集してもよい
+	// 結果の反映（markQueryCompleted / markQueryFailed）は呼び出し側で行う
+	// Web版はスレッドが使えないので使用不可
+	static AsyncTask<Array<QueryResult>> VerifyAllQueriesAsync(const Stage& stage, int32 maxStepsPerQuery = DefaultMaxSteps);
+
+private:
+	Stage& m_stage;
+
+	Optional<bool> checkVerdict();
+	void removeFallenBalls();
+	bool isAllBallsFinished() const;
+	bool isAllBallsAsleep() const;
+	void updateGoalDwell();
+	void registerNewBalls();
+	void stopSlowBalls();
+};
@@ -0,0 +1,306 @@
+﻿#pragma once
+
+# include <Siv3D.hpp>
+
+// SlotTable の要素を指すハンドル
+// スロットは使い回すので、ID だけでなく世代も合っているときだけ同じ要素を指す
+struct SlotHandle {
+	int32 id = -1;
+	uint32 generation = 0;
+
+	bool operator==(const SlotHandle&) const = default;
+};
+
+// ID → 値 の表（点・エッジ・配置ボールに使う）
+// ID をそのまま添字にして連続した配列に置く。削除しても他の要素の ID は変わらないので、
+// レイヤー順序やグループが持っている ID を書き換えずに済む
+// 削除したスロットは空きとして覚えておき、次の追加で使い回す（スロット数は同時に生きている要素の最大数までしか増えない）
+// スロットごとに世代を持ち、削除で進める。古い ID を持ち続ける側は SlotHandle で持てば、使い回されたことが分かる
+// 走査は追加した順（空きスロットを使い回しても、配列で持っていたときと同じ順になる）
+template <class T>
+class SlotTable {
+public:
+	// 受け付ける ID の上限（壊れた保存データの ID で巨大な確保をしないように）
+	static constexpr int32 MaxSlotCount = (1 << 22);
+
+	SlotTable() = default;
+
+	// 保存形式（詰めた配列）から作る。ID は添字と同じ
+	explicit SlotTable(const Array<T>& values)
+	{
+		if (MaxSlotCount < values.size()) {
+			throw std::length_error("SlotTable: too many values");
+		}
+		for (const auto& value : values) {
+			insert(value);
+		}
+	}
+
+	SlotTable(const SlotTable&) = default;
+	SlotTable(SlotTable&&) noexcept = default;
+
+	// 中身は other に置き換えるが、世代と version() は前の値より必ず進める
+	// （Undo で古い表に戻しても、戻す前に取ったハンドルやキャッシュのキーが通ってしまわないように）
+	SlotTable& operator=(const SlotTable& other)
+	{
+		if (this == &other) {
+			return *this;
+		}
+
+		Array<uint32> generations = other.m_generations;
+		if (generations.size() < m_generations.size()) {
+			generations.resize(m_generations.size(), 0);
+		}
+		for (size_t i = 0; i < m_generations.size(); ++i) {
+			generations[i] = Max(generations[i], m_generations[i] + 1);
+		}
+		const uint64 version = Max(m_version, other.m_version) + 1;
+
+		m_values = other.m_values;
+		m_alive = other.m_alive;
+		m_prev = other.m_prev;
+		m_next = other.m_next;
+		m_freeIds = other.m_freeIds;
+		m_head = other.m_head;
+		m_tail = other.m_tail;
+		m_count = other.m_count;
+		m_generations = std::move(generations);
+		m_version = version;
+		return *this;
+	}
+
+	static bool IsValidId(int32 id) { return 0 <= id && id < MaxSlotCount; }
+
+	bool contains(int32 id) const { return 0 <= id && id < m_alive.size() && m_alive[id]; }
+
+	SlotHandle handleOf(int32 id) const { return SlotHandle{ id, generationOf(id) }; }
+
+	// ハンドルを取ったときの要素がまだ生きているか
+	bool isAlive(const SlotHandle& handle) const { return contains(handle.id) && generationOf(handle.id) == handle.generation; }
+
+	// Array の添字と同じく確かめない（生きている ID であること）
+	const T& operator[](int32 id) const { return m_values[id]; }
+	T& operator[](int32 id) { return m_values[id]; }
+
+	const T& at(int32 id) const
+	{
+		if (not contains(id)) {
+			throw std::out_of_range("SlotTable::at: invalid id");
+		}
+		return m_values[id];
+	}
+
+	T& at(int32 id)
+	{
+		return const_cast<T&>(std::as_const(*this).at(id));
+	}
+
+	// 空きスロットがあれば使い回して追加し、ID を返す
+	int32 insert(const T& value)
+	{
+		while (not m_freeIds.empty()) {
+			const int32 id = m_freeIds.back();
+			m_freeIds.pop_back();
+			// emplaceAt で埋められた空きは飛ばす
+			if (not m_alive[id]) {
+				m_values[id] = value;
+				revive(id);
+				return id;
+			}
+		}
+
+		const int32 id = slotCount();
+		if (not IsValidId(id)) {
+			throw std::length_error("SlotTable::insert: too many slots");
+		}
+		growTo(id + 1);
+		m_values[id] = value;
+		revive(id);
+		return id;
+	}
+
+	// ID を指定して置く（読み込み・複製で ID を保ちたいとき）。既にあれば上書きする
+	T& emplaceAt(int32 id, const T& value = T{})
+	{
+		if (not IsValidId(id)) {
+			throw std::out_of_range("SlotTable::emplaceAt: invalid id");
+		}
+		if (m_values.size() <= id) {
+			const int32 oldSize = slotCount();
+			growTo(id + 1);
+			// 間に空いたスロットも使い回せるようにする
+			for (int32 i = oldSize; i < id; ++i) {
+				m_freeIds.push_back(i);
+			}
+		}
+		if (not m_alive[id]) {
+			revive(id);
+		}
+		m_values[id] = value;
+		return m_values[id];
+	}
+
+	void erase(int32 id)
+	{
+		if (not contains(id)) {
+			return;
+		}
+		unlink(id);
+		m_alive[id] = 0;
+		m_values[id] = T{};  // 空きスロットの中身をそろえておく（スナップショットの比較で差にならないように）
+		++m_generations[id];
+		m_freeIds.push_back(id);
+		--m_count;
+		++m_version;
+	}
+
+	void clear()
+	{
+		// 世代は残して進めておく（消す前のハンドルが、後で同じスロットに入った要素に通らないように）
+		for (int32 id = 0; id < slotCount(); ++id) {
+			if (m_alive[id]) ++m_generations[id];
+		}
+		m_values.clear();
+		m_alive.clear();
+		m_prev.clear();
+		m_next.clear();
+		m_freeIds.clear();
+		m_head = m_tail = -1;
+		m_count = 0;
+		++m_version;
+	}
+
+	int32 size() const { return m_count; }
+	bool empty() const { return m_count == 0; }
+
+	// 確保済みのスロット数（使われている最大の ID + 1 以上）
+	int32 slotCount() const { return static_cast<int32>(m_values.size()); }
+
+	// 追加・削除・代入のたびに進む（キャッシュがどの状態の表から作られたかを見分ける）
+	uint64 version() const { return m_version; }
+
+	template <class Predicate>
+	int32 count_if(Predicate predicate) const
+	{
+		int32 count = 0;
+		for (const auto& [id, value] : *this) {
+			if (predicate(value)) ++count;
+		}
+		return count;
+	}
+
+	// 保存用に、生きている要素を追加した順に詰める
+	// idToIndex を渡すと ID → 詰めた後の添字 を入れる（空きスロットは -1）
+	Array<T> toArray(Array<int32>* idToIndex = nullptr) const
+	{
+		Array<T> result;
+		result.reserve(m_count);
+		if (idToIndex) {
+			idToIndex->assign(m_values.size(), -1);
+		}
+		for (const auto& [id, value] : *this) {
+			if (idToIndex) {
+				(*idToIndex)[id] = static_cast<int32>(result.size());
+			}
+			result.push_back(value);
+		}
+		return result;
+	}
+
+	// 中身と並びだけを比べる（世代・空きの順・version() は比べない）
+	bool operator==(const SlotTable& other) const
+	{
+		return m_values == other.m_values
+			&& m_alive == other.m_alive
+			&& m_prev == other.m_prev
+			&& m_next == other.m_next
+			&& m_head == other.m_head
+			&& m_tail == other.m_tail;
+	}
+
+	// 生きている要素だけを追加した順に (id, value) で辿る
+	class const_iterator {
+	public:
+		const_iterator(const SlotTable* table, int32 id)
+			: m_table(table), m_id(id) {}
+
+		std::pair<int32, const T&> operator*() const { return { m_id, m_table->m_values[m_id] }; }
+
+		const_iterator& operator++()
+		{
+			m_id = m_table->m_next[m_id];
+			return *this;
+		}
+
+		bool operator==(const const_iterator& other) const { return m_id == other.m_id; }
+
+	private:
+		const SlotTable* m_table;
+		int32 m_id;
+	};
+
+	const_iterator begin() const { return const_iterator{ this, m_head }; }
+	const_iterator end() const { return const_iterator{ this, -1 }; }
+
+	// 概算のメモリ使用量
+	size_t memoryUsage() const
+	{
+		return m_values.size() * (sizeof(T) + sizeof(uint8) + sizeof(int32) * 2)
+			+ m_generations.size() * sizeof(uint32)
+			+ m_freeIds.size() * sizeof(int32);
+	}
+
+private:
+	Array<T> m_values;            // ID → 値（空きスロットの値は使わない）
+	Array<uint8> m_alive;         // ID → 生きているか
+	Array<uint32> m_generations;  // ID → 世代（削除で進む。clear() でも縮めない）
+	Array<int32> m_prev;          // 追加した順の連結リスト（-1 が端）
+	Array<int32> m_next;
+	Array<int32> m_freeIds;       // 空きスロットの ID（後から入れたものから使い回す）
+	int32 m_head = -1;
+	int32 m_tail = -1;
+	int32 m_count = 0;
+	uint64 m_version = 0;
+
+	uint32 generationOf(int32 id) const
+	{
+		return (0 <= id && id < m_generations.size()) ? m_generations[id] : 0;
+	}
+
+	void growTo(int32 newSize)
+	{
+		m_values.resize(newSize);
+		m_alive.resize(newSize, 0);
+		m_prev.resize(newSize, -1);
+		m_next.resize(newSize, -1);
+		if (m_generations.size() < newSize) {
+			m_generations.resize(newSize, 0);
+		}
+	}
+
+	// 空きスロットを生きている状態にし、追加した順の末尾につなぐ
+	void revive(int32 id)
+	{
+		m_alive[id] = 1;
+		m_prev[id] = m_tail;
+		m_next[id] = -1;
+		if (m_tail != -1) {
+			m_next[m_tail] = id;
+		}
+		else {
+			m_head = id;
+		}
+		m_tail = id;
+		++m_count;
+		++m_version;
+	}
+
+	void unlink(int32 id)
+	{
+		const int32 prev = m_prev[id];
+		const int32 next = m_next[id];
+		if (prev != -1) m_next[prev] = next; else m_head = next;
+		if (next != -1) m_prev[next] = prev; else m_tail = prev;
+		m_prev[id] = m_next[id] = -1;
+	}
+};
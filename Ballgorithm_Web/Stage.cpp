@@ -3,19 +3,192 @@
 # include "GeometryUtils.hpp"
 # include "IndexedDB.hpp"
 
+namespace {
+	// 端点を共有する線分を、分岐（次数3以上）や端で切れる折れ線にまとめる
+	// 長さ0の線分はそのまま2点の折れ線として返す
+	Array<LineString> BuildLineChains(const Array<Line>& lines)
+	{
+		Array<LineString> chains;
+		HashTable<Vec2, Array<int32>> adjacency;
+		Array<bool> used(lines.size(), false);
+
+		for (int32 i = 0; i < lines.size(); ++i) {
+			if (lines[i].begin == lines[i].end) {
+				chains.push_back(LineString{ lines[i].begin, lines[i].end });
+				used[i] = true;
+				continue;
+			}
+			adjacency[lines[i].begin].push_back(i);
+			adjacency[lines[i].end].push_back(i);
+		}
+
+		auto walk = [&](const Vec2& start, int32 firstLine) {
+			LineString chain{ start };
+			Vec2 current = start;
+			int32 lineIndex = firstLine;
+			while (true) {
+				used[lineIndex] = true;
+				const Line& line = lines[lineIndex];
+				current = (line.begin == current) ? line.end : line.begin;
+				chain.push_back(current);
+
+				// 輪になったか、分岐・端に着いたら終わり
+				if (current == start) break;
+				const auto& next = adjacency.at(current);
+				if (next.size() != 2) break;
+				lineIndex = (next[0] == lineIndex) ? next[1] : next[0];
+				if (used[lineIndex]) break;
+			}
+			chains.push_back(std::move(chain));
+		};
+
+		// 端・分岐から辿る
+		for (const auto& [pos, lineIndices] : adjacency) {
+			if (lineIndices.size() == 2) continue;
+			for (int32 lineIndex : lineIndices) {
+				if (not used[lineIndex]) {
+					walk(pos, lineIndex);
+				}
+			}
+		}
+
+		// 残りは分岐の無い輪
+		for (int32 i = 0; i < lines.size(); ++i) {
+			if (not used[i]) {
+				walk(lines[i].begin, i);
+			}
+		}
+
+		return chains;
+	}
+
+	// base と同じ内容ならそれを共有し、違えば複製する
+	template <class Type>
+	std::shared_ptr<const Type> ShareIfUnchanged(const std::shared_ptr<const Type>& base, const Type& current)
+	{
+		if (base && *base == current) {
+			return base;
+		}
+		return std::make_shared<const Type>(current);
+	}
+
+	size_t GroupMemoryUsage(const Group& group)
+	{
+		size_t bytes = sizeof(Group);
+		bytes += (group.m_pointIds.size() + group.m_placedBallIds.size()
+			+ group.m_startCircleIds.size() + group.m_goalAreaIds.size()) * sizeof(int32) * 2;  // ハッシュの空きぶんを見込む
+		for (const auto& g : group.m_groups) {
+			bytes += GroupMemoryUsage(g);
+		}
+		return bytes;
+	}
+
+	// グループ内の配置ボール ID を、送信形式の詰めた添字に付け替える
+	void RemapPlacedBallIds(Group& group, const Array<int32>& placedBallIndexOfId)
+	{
+		HashSet<int32> remapped;
+		for (auto id : group.m_placedBallIds) {
+			remapped.insert(placedBallIndexOfId[id]);
+		}
+		group.m_placedBallIds = std::move(remapped);
+		for (auto& g : group.m_groups) {
+			RemapPlacedBallIds(g, placedBallIndexOfId);
+		}
+	}
+
+	// グループが指すものがすべて record にあるか
+	bool HasValidMemberIds(const Group& group, const StageRecord& record)
+	{
+		for (auto id : group.m_pointIds) {
+			if (not record.m_points.contains(id)) return false;
+		}
+		for (auto id : group.m_placedBallIds) {
+			if (not InRange(id, 0, static_cast<int32>(record.m_placedBalls.size()) - 1)) return false;
+		}
+		for (auto id : group.m_startCircleIds) {
+			if (not InRange(id, 0, static_cast<int32>(record.m_startCircles.size()) - 1)) return false;
+		}
+		for (auto id : group.m_goalAreaIds) {
+			if (not InRange(id, 0, static_cast<int32>(record.m_goalAreas.size()) - 1)) return false;
+		}
+		for (const auto& g : group.m_groups) {
+			if (not HasValidMemberIds(g, record)) return false;
+		}
+		return true;
+	}
+}
+
+namespace {
+	// キャッシュの無効化漏れを DEBUG ビルドで止める
+	// （数のずれを見て黙って作り直すと漏れが隠れるうえ、数の変わらない移動の漏れはどのみち拾えない）
+	void AssertCacheInSync([[maybe_unused]] bool inSync, [[maybe_unused]] StringView cacheName)
+	{
+#if SIV3D_BUILD(DEBUG)
+		if (not inSync) {
+			throw Error{ U"Stage: {} was not invalidated after an edit"_fmt(cacheName) };
+		}
+#endif
+	}
+}
+
+namespace {
+	// スナップショットの要素のうち shouldCount が true を返すものの概算バイト数（StageSnapshot 自体を含む）
+	template <class Predicate>
+	size_t SnapshotMemoryUsage(const StageSnapshot& snapshot, Predicate shouldCount)
+	{
+		size_t bytes = sizeof(StageSnapshot);
+		auto add = [&](const auto& part, auto&& measure) {
+			if (part && shouldCount(part)) {
+				bytes += measure(*part);
+			}
+		};
+		auto arrayBytes = [](const auto& array) { return array.size() * sizeof(array[0]); };
+
+		auto slotTableBytes = [](const auto& table) { return table.memoryUsage(); };
+
+		add(snapshot.points, slotTableBytes);
+		add(snapshot.edges, slotTableBytes);
+		add(snapshot.groups, [](const HashTable<int32, Group>& gs) {
+			size_t b = 0;
+			for (const auto& [id, g] : gs) b += sizeof(int32) + GroupMemoryUsage(g);
+			return b;
+		});
+		add(snapshot.placedBalls, slotTableBytes);
+		add(snapshot.inventorySlots, arrayBytes);
+		add(snapshot.layerOrder, arrayBytes);
+		add(snapshot.nonEditableAreas, arrayBytes);
+		return bytes;
+	}
+}
+
+size_t StageSnapshot::memoryUsage(HashSet<const void*>& counted) const
+{
+	return SnapshotMemoryUsage(*this, [&](const auto& part) { return counted.insert(part.get()).second; });
+}
+
+size_t StageSnapshot::exclusiveMemoryUsage() const
+{
+	return SnapshotMemoryUsage(*this, [](const auto& part) { return part.use_count() == 1; });
+}
+
 Stage::Stage()
 {
 }
 
 int32 Stage::addLine(const Line& line, bool isLocked)
 {
-	int32 id1 = m_nextPointId++;
-	int32 id2 = m_nextPointId++;
-	m_points[id1] = line.begin;
-	m_points[id2] = line.end;
-	int32 edgeIndex = m_edges.size();
-	m_edges.push_back(Edge{ { id1, id2 }, isLocked });
+	const int32 id1 = m_points.insert(line.begin);
+	const int32 id2 = m_points.insert(line.end);
+	const int32 edgeIndex = m_edges.insert(Edge{ { id1, id2 }, isLocked });
 	m_layerOrder.push_back(LayerObject{ LayerObjectType::Edge, edgeIndex });
+	expandBounds(RectF{ line.begin, 0, 0 });
+	expandBounds(RectF{ line.end, 0, 0 });
+	touchEditGeneration();
+	m_isAreaSelectIndexDirty = true;
+	insertToPickGrid(m_layerOrder.size() - 1);
+	insertToIncidentEdgeIndex(edgeIndex);
+	insertToEdgeSegmentSet(edgeIndex);
+	addEdgeToScore(edgeIndex);
 	return edgeIndex;
 }
 
@@ -24,6 +197,10 @@ int32 Stage::addStartCircle(const StartCircle& startCircle)
 	int32 index = m_startCircles.size();
 	m_startCircles.push_back(startCircle);
 	m_layerOrder.push_back(LayerObject{ LayerObjectType::StartCircle, index });
+	expandBounds(startCircle.circle.boundingRect());
+	touchEditGeneration();
+	m_isAreaSelectIndexDirty = true;
+	insertToPickGrid(m_layerOrder.size() - 1);
 	return index;
 }
 
@@ -32,14 +209,22 @@ int32 Stage::addGoalArea(const GoalArea& goalArea)
 	int32 index = m_goalAreas.size();
 	m_goalAreas.push_back(goalArea);
 	m_layerOrder.push_back(LayerObject{ LayerObjectType::GoalArea, index });
+	expandBounds(goalArea.rect);
+	touchEditGeneration();
+	m_isAreaSelectIndexDirty = true;
+	insertToPickGrid(m_layerOrder.size() - 1);
 	return index;
 }
 
 int32 Stage::addPlacedBall(const PlacedBall& placedBall)
 {
-	int32 index = m_placedBalls.size();
-	m_placedBalls.push_back(placedBall);
+	const int32 index = m_placedBalls.insert(placedBall);
 	m_layerOrder.push_back(LayerObject{ LayerObjectType::PlacedBall, index });
+	expandBounds(Circle{ placedBall.center, GetBallRadius(placedBall.kind) }.boundingRect());
+	touchEditGeneration();
+	m_isAreaSelectIndexDirty = true;
+	insertToPickGrid(m_layerOrder.size() - 1);
+	addPlacedBallToScore(index);
 	return index;
 }
 
@@ -48,38 +233,37 @@ void Stage::bringToFront(LayerObject obj)
 	// 既存の位置から削除して末尾に追加
 	m_layerOrder.remove(obj);
 	m_layerOrder.push_back(obj);
+	invalidatePickGrid();
 }
 
 void Stage::removeFromLayerOrder(LayerObject obj)
 {
 	m_layerOrder.remove(obj);
+	invalidatePickGrid();
 }
 
-void Stage::updateLayerOrderAfterRemoval(LayerObjectType type, int32 removedId)
-{
-	// 削除されたオブジェクトをレイヤー順序から除去
-	m_layerOrder.remove(LayerObject{ type, removedId });
-	
-	// 削除されたIDより大きいIDを持つ同じタイプのオブジェクトのIDを1減らす
-	for (auto& obj : m_layerOrder) {
-		if (obj.type == type && obj.id > removedId) {
-			--obj.id;
-		}
-	}
-}
-
-void Stage::removePlacedBall(int32 index)
+void Stage::removePlacedBall(int32 id)
 {
-	if (index >= m_placedBalls.size()) return;
-	m_placedBalls.remove_at(index);
-	updateLayerOrderAfterRemoval(LayerObjectType::PlacedBall, index);
+	if (not m_placedBalls.contains(id)) return;
+	if (not m_isScoreCountersDirty) {
+		if (not m_placedBalls[id].isLocked) --m_scoreCounters.unlockedPlacedBallCount;
+		--m_scoreCounters.placedBallCount;
+	}
+	// 他のボールの ID は変わらないので、レイヤー順序からは外すだけでよい
+	m_placedBalls.erase(id);
+	m_layerOrder.remove(LayerObject{ LayerObjectType::PlacedBall, id });
+	invalidateSpatialCaches();
+	invalidateGroupArena();
 }
 
-void Stage::createGroup(const Group& group)
+void Stage::createGroup(Group group)
 {
 	if (group.size() >= 2) {
 		int32 newGroupId = m_nextGroupId++;
-		m_groups[newGroupId] = group;
+		const auto& added = (m_groups[newGroupId] = std::move(group));
+		if (not m_isGroupArenaDirty) {
+			m_groupArena.add(newGroupId, added);
+		}
 	}
 }
 
@@ -89,6 +273,9 @@ int32 Stage::createLockedGroup(const Group& group)
 	Group lockedGroup = group;
 	lockedGroup.isLocked = true;
 	m_groups[newGroupId] = lockedGroup;
+	if (not m_isGroupArenaDirty) {
+		m_groupArena.add(newGroupId, lockedGroup);
+	}
 	return newGroupId;
 }
 
@@ -114,17 +301,24 @@ void Stage::createGroupFromSelection(HashSet<SelectedID>& selectedIDs)
 			addGoalAreaIds.insert(s.id);
 		}
 		else if (s.type == SelectType::Group) {
-			newGroup.insert(m_groups.at(s.id));
+			// 部分木はコピーせずに付け替える（平らにした表では外すだけで、新しいグループを作るときに末尾に足す）
+			newGroup.insert(std::move(m_groups.at(s.id)));
 			m_groups.erase(s.id);
+			if (not m_isGroupArenaDirty) {
+				m_groupArena.remove(s.id);
+			}
 		}
 	}
 	
-	// Point を追加
+	// Point を追加（両端とも選ばれているエッジの点だけ）
 	auto& mut_points = newGroup.m_pointIds;
-	for (auto& edge : m_edges) {
-		if (addPointIds.contains(edge[0]) and addPointIds.contains(edge[1])) {
-			mut_points.insert(edge[0]);
-			mut_points.insert(edge[1]);
+	for (auto pid : addPointIds) {
+		for (auto edgeIndex : incidentEdges(pid)) {
+			const auto& edge = m_edges[edgeIndex];
+			if (addPointIds.contains(edge[0]) and addPointIds.contains(edge[1])) {
+				mut_points.insert(edge[0]);
+				mut_points.insert(edge[1]);
+			}
 		}
 	}
 	
@@ -146,18 +340,26 @@ void Stage::createGroupFromSelection(HashSet<SelectedID>& selectedIDs)
 		mut_goalAreas.insert(goalAreaId);
 	}
 	
-	createGroup(newGroup);
+	createGroup(std::move(newGroup));
 	selectedIDs.clear();
 }
 
 void Stage::ungroup(int32 groupId)
 {
-	const auto& group = m_groups.at(groupId);
-	for (const auto& g : group.m_groups) {
+	// 子の部分木はコピーせずにトップレベルへ付け替える
+	Group group = std::move(m_groups.at(groupId));
+	m_groups.erase(groupId);
+	Array<int32> childGroupIds;
+	childGroupIds.reserve(group.m_groups.size());
+	for (auto& g : group.m_groups) {
 		int32 newGroupId = m_nextGroupId++;
-		m_groups[newGroupId] = g;
+		m_groups[newGroupId] = std::move(g);
+		childGroupIds.push_back(newGroupId);
+	}
+	// 平らにした表では子のノードをそのままトップレベルに付け替える
+	if (not m_isGroupArenaDirty) {
+		m_groupArena.ungroup(groupId, childGroupIds);
 	}
-	m_groups.erase(groupId);
 }
 
 Vec2 Stage::getBeginPointOfGroup(const Group& group) const
@@ -182,42 +384,120 @@ Vec2 Stage::getBeginPointOfGroup(const Group& group) const
 
 Optional<int32> Stage::findTopGroup(int32 pointId) const
 {
-	for (const auto& [groupId, group] : m_groups) {
-		if (group.containsPointRecursive(pointId)) {
-			return groupId;
-		}
-	}
-	return none;
+	return groupArena().findTopGroup(GroupArena::Points, pointId);
 }
 
 Optional<int32> Stage::findTopGroupForPlacedBall(int32 placedBallId) const
 {
-	for (const auto& [groupId, group] : m_groups) {
-		if (group.containsPlacedBallRecursive(placedBallId)) {
-			return groupId;
+	return groupArena().findTopGroup(GroupArena::PlacedBalls, placedBallId);
+}
+
+Optional<int32> Stage::findTopGroupForStartCircle(int32 startCircleId) const
+{
+	return groupArena().findTopGroup(GroupArena::StartCircles, startCircleId);
+}
+
+Optional<int32> Stage::findTopGroupForGoalArea(int32 goalAreaId) const
+{
+	return groupArena().findTopGroup(GroupArena::GoalAreas, goalAreaId);
+}
+
+const GroupArena& Stage::groupArena() const
+{
+	// 使われなくなったノードが増えすぎたときも詰め直す
+	if (m_isGroupArenaDirty || m_groupArena.needsCompaction()) {
+		m_groupArena.clear();
+		for (const auto& [groupId, group] : m_groups) {
+			m_groupArena.add(groupId, group);
 		}
+		m_isGroupArenaDirty = false;
 	}
-	return none;
+	AssertCacheInSync(m_groupArena.groupCount == m_groups.size(), U"GroupArena");
+	return m_groupArena;
 }
 
-Optional<int32> Stage::findTopGroupForStartCircle(int32 startCircleId) const
+const AreaSelectIndex& Stage::areaSelectIndex() const
 {
-	for (const auto& [groupId, group] : m_groups) {
-		if (group.containsStartCircleRecursive(startCircleId)) {
-			return groupId;
+	const AreaSelectIndex::Counts counts{
+		.edges = static_cast<int32>(m_edges.size()),
+		.startCircles = static_cast<int32>(m_startCircles.size()),
+		.goalAreas = static_cast<int32>(m_goalAreas.size()),
+		.placedBalls = static_cast<int32>(m_placedBalls.size()),
+		.groups = static_cast<int32>(m_groups.size()),
+	};
+	// グループの構成は GroupArena の版で見分ける（グループを書き換える側はこの索引を気にしなくてよい）
+	const GroupArena& arena = groupArena();
+	if (not m_isAreaSelectIndexDirty && m_areaSelectIndex.groupArenaVersion == arena.version) {
+		AssertCacheInSync(m_areaSelectIndex.counts == counts, U"AreaSelectIndex");
+		return m_areaSelectIndex;
+	}
+
+	AreaSelectIndex& index = m_areaSelectIndex;
+	index.clear();
+	index.counts = counts;
+	index.groupArenaVersion = arena.version;
+
+	Array<bool> addedPoints(m_points.slotCount(), false);
+	for (const auto& [edgeId, edge] : m_edges) {
+		if (edge.isLocked) continue;
+		for (auto pid : edge.ids) {
+			if (addedPoints[pid]) continue;
+			addedPoints[pid] = true;
+			index.addAnchor(m_points.at(pid), SelectType::Point, pid, findTopGroup(pid));
 		}
 	}
-	return none;
+	for (int32 i = 0; i < m_startCircles.size(); ++i) {
+		if (m_startCircles[i].isLocked) continue;
+		index.addAnchor(m_startCircles[i].circle.center, SelectType::StartCircle, i, findTopGroupForStartCircle(i));
+	}
+	for (int32 i = 0; i < m_goalAreas.size(); ++i) {
+		if (m_goalAreas[i].isLocked) continue;
+		index.addAnchor(m_goalAreas[i].rect.center(), SelectType::GoalArea, i, findTopGroupForGoalArea(i));
+	}
+	for (const auto& [id, ball] : m_placedBalls) {
+		if (ball.isLocked) continue;
+		index.addAnchor(ball.center, SelectType::PlacedBall, id, findTopGroupForPlacedBall(id));
+	}
+
+	// グループの外接矩形は、範囲選択でメンバーごとに判定していた位置と同じものから作る
+	for (const auto& [groupId, root] : arena.rootOfGroup) {
+		const auto members = arena.membersOf(groupId);
+		for (auto id : members.pointIds) index.expandGroup(groupId, m_points.at(id));
+		for (auto id : members.startCircleIds) index.expandGroup(groupId, m_startCircles[id].circle.center);
+		for (auto id : members.goalAreaIds) index.expandGroup(groupId, m_goalAreas[id].rect.center());
+		for (auto id : members.placedBallIds) index.expandGroup(groupId, m_placedBalls[id].center);
+	}
+
+	index.build();
+	m_isAreaSelectIndexDirty = false;
+	return index;
 }
 
-Optional<int32> Stage::findTopGroupForGoalArea(int32 goalAreaId) const
+const Array<int32>& Stage::incidentEdges(int32 pointId) const
 {
-	for (const auto& [groupId, group] : m_groups) {
-		if (group.containsGoalAreaRecursive(goalAreaId)) {
-			return groupId;
+	return incidentEdgeIndex().of(pointId);
+}
+
+const IncidentEdgeIndex& Stage::incidentEdgeIndex() const
+{
+	if (m_isIncidentEdgeIndexDirty) {
+		m_incidentEdgeIndex.clear();
+		m_isIncidentEdgeIndexDirty = false;
+		for (const auto& [edgeId, edge] : m_edges) {
+			m_incidentEdgeIndex.add(edgeId, edge);
 		}
 	}
-	return none;
+	AssertCacheInSync(m_incidentEdgeIndex.edgeCount == m_edges.size(), U"IncidentEdgeIndex");
+	return m_incidentEdgeIndex;
+}
+
+void Stage::insertToIncidentEdgeIndex(int32 edgeIndex) const
+{
+	// 無効化されていれば次の参照で全体を作り直すので何もしない
+	if (m_isIncidentEdgeIndexDirty) {
+		return;
+	}
+	m_incidentEdgeIndex.add(edgeIndex, m_edges[edgeIndex]);
 }
 
 Group Stage::mapGroupIDs(const Group& group, const HashTable<int32, int32>& idMapping) const
@@ -238,15 +518,25 @@ PointEdgeGroup Stage::copySelectedObjects(const HashSet<SelectedID>& selectedIDs
 	HashSet<int32> allSelectedPointIds;
 	for (const auto& s : selectedIDs) {
 		if (s.type == SelectType::Point) allSelectedPointIds.insert(s.id);
-		else if (s.type == SelectType::Group) allSelectedPointIds.merge(m_groups.at(s.id).getAllPointIds());
+		else if (s.type == SelectType::Group) {
+			for (auto pid : groupMembers(s.id).pointIds) allSelectedPointIds.insert(pid);
+		}
 	}
-	for (const auto& edge : m_edges) {
-		if (allSelectedPointIds.contains(edge[0]) or allSelectedPointIds.contains(edge[1])) {
-			result.m_points[edge[0]] = m_points.at(edge[0]);
-			result.m_points[edge[1]] = m_points.at(edge[1]);
-			result.m_edges.push_back(edge.ids);
+	// 選ばれた点につながるエッジだけを集め、貼り付け後も元のレイヤー順になるようレイヤー順序に沿って並べる
+	// （エッジID は使い回されるので、ID の順は追加した順と限らない）
+	Array<bool> isCopiedEdge(m_edges.slotCount(), false);
+	for (auto pid : allSelectedPointIds) {
+		for (auto edgeId : incidentEdges(pid)) {
+			isCopiedEdge[edgeId] = true;
 		}
 	}
+	for (const auto& obj : m_layerOrder) {
+		if (obj.type != LayerObjectType::Edge || not isCopiedEdge[obj.id]) continue;
+		const auto& edge = m_edges[obj.id];
+		result.m_points[edge[0]] = m_points.at(edge[0]);
+		result.m_points[edge[1]] = m_points.at(edge[1]);
+		result.m_edges.push_back(edge.ids);
+	}
 	for (const auto& s : selectedIDs) {
 		if (s.type == SelectType::Group) {
 			const auto& group = m_groups.at(s.id);
@@ -280,55 +570,85 @@ void Stage::deltaMoveGroup(const Group& group, const Vec2& deltaMove)
 	for (auto goalAreaId : allGoalAreaIds) {
 		m_goalAreas[goalAreaId].rect.pos += deltaMove;
 	}
+
+	invalidateSpatialCaches();
+	invalidateScoreCounters();
 }
 
 void Stage::eraseSelectedPoints(const HashSet<SelectedID>& selectedIDs)
 {
-	HashSet<int32> pointsToErase;
-	Array<int32> placedBallsToErase;
+	Array<bool> pointMarks(m_points.slotCount(), false);
+	Array<bool> placedBallMarks(m_placedBalls.slotCount(), false);
+	auto markPoint = [&](int32 pid) { if (0 <= pid && pid < pointMarks.size()) pointMarks[pid] = true; };
+	auto markPlacedBall = [&](int32 bid) { if (0 <= bid && bid < placedBallMarks.size()) placedBallMarks[bid] = true; };
 	
+	// グループは印を付け終えてから消す（途中で消すと平らにした表を毎回作り直すことになる）
+	Array<int32> erasedGroupIds;
 	for (const auto& s : selectedIDs) {
-		if (s.type == SelectType::Point) pointsToErase.insert(s.id);
+		if (s.type == SelectType::Point) markPoint(s.id);
 		else if (s.type == SelectType::Group) {
-			auto groupPointIds = m_groups.at(s.id).getAllPointIds();
-			for (auto pid : groupPointIds) pointsToErase.insert(pid);
-			
-			auto groupBallIds = m_groups.at(s.id).getAllPlacedBallIds();
-			for (auto bid : groupBallIds) placedBallsToErase.push_back(bid);
-			
-			m_groups.erase(s.id);
+			const auto members = groupMembers(s.id);
+			for (auto pid : members.pointIds) markPoint(pid);
+			for (auto bid : members.placedBallIds) markPlacedBall(bid);
+			erasedGroupIds.push_back(s.id);
 		}
 		else if (s.type == SelectType::PlacedBall) {
-			placedBallsToErase.push_back(s.id);
+			markPlacedBall(s.id);
 		}
 	}
-	
-	// PlacedBall を削除（インデックスが大きい順に削除）
-	std::sort(placedBallsToErase.begin(), placedBallsToErase.end(), std::greater<int32>());
-	for (auto idx : placedBallsToErase) {
-		m_placedBalls.remove_at(idx);
-		updateLayerOrderAfterRemoval(LayerObjectType::PlacedBall, idx);
+	for (auto groupId : erasedGroupIds) {
+		m_groups.erase(groupId);
 	}
-	
-	Array<int32> edgesToErase;
-	for (int32 i = 0; i < m_edges.size(); ++i) {
-		const auto& edge = m_edges[i];
-		if (pointsToErase.contains(edge[0]) or pointsToErase.contains(edge[1])) {
-			edgesToErase.push_back(i);
-			pointsToErase.insert(edge[0]);
-			pointsToErase.insert(edge[1]);
+
+	eraseMarkedObjects(pointMarks, placedBallMarks);
+}
+
+void Stage::eraseMarkedObjects(Array<bool>& pointMarks, const Array<bool>& placedBallMarks)
+{
+	// 印の付いた点を端点に持つエッジを消し、その反対側の点も消す（後ろのエッジへの波及は従来の走査順と同じ）
+	auto isMarked = [&](int32 pid) { return 0 <= pid && pid < pointMarks.size() && pointMarks[pid]; };
+	Array<int32> erasedEdgeIds;
+	for (const auto& [id, edge] : m_edges) {
+		if (isMarked(edge[0]) or isMarked(edge[1])) {
+			if (not m_isScoreCountersDirty) {
+				if (not edge.isLocked) {
+					--m_scoreCounters.unlockedEdgeCount;
+					m_scoreCounters.totalLengthUnits -= ScoreCounters::LengthUnits(m_points.at(edge[0]), m_points.at(edge[1]));
+				}
+				--m_scoreCounters.edgeCount;
+			}
+			pointMarks[edge[0]] = true;
+			pointMarks[edge[1]] = true;
+			erasedEdgeIds.push_back(id);
 		}
 	}
-	// Edge も大きい順に削除してレイヤー順序を更新
-	std::sort(edgesToErase.begin(), edgesToErase.end(), std::greater<int32>());
-	for (auto idx : edgesToErase) {
-		m_edges.remove_at(idx);
-		updateLayerOrderAfterRemoval(LayerObjectType::Edge, idx);
+	for (auto id : erasedEdgeIds) {
+		m_edges.erase(id);
 	}
-	
-	for (auto pointId : pointsToErase) {
-		m_points.erase(pointId);
+
+	for (int32 id = 0; id < placedBallMarks.size(); ++id) {
+		if (not placedBallMarks[id] || not m_placedBalls.contains(id)) continue;
+		if (not m_isScoreCountersDirty) {
+			if (not m_placedBalls[id].isLocked) --m_scoreCounters.unlockedPlacedBallCount;
+			--m_scoreCounters.placedBallCount;
+		}
+		m_placedBalls.erase(id);
 	}
+
+	// 残ったものの ID は変わらないので、レイヤー順序は消えたものを外すだけでよい
+	m_layerOrder.remove_if([&](const LayerObject& obj) {
+		if (obj.type == LayerObjectType::Edge) return not m_edges.contains(obj.id);
+		if (obj.type == LayerObjectType::PlacedBall) return not m_placedBalls.contains(obj.id);
+		return false;
+	});
+
+	for (int32 pid = 0; pid < pointMarks.size(); ++pid) {
+		if (pointMarks[pid]) m_points.erase(pid);
+	}
+
+	invalidateSpatialCaches();
+	invalidateGroupArena();
+	invalidateIncidentEdgeIndex();
 }
 
 void Stage::startSimulationWithSave()
@@ -343,11 +663,12 @@ void Stage::startSimulationWithSave()
 void Stage::startSimulation()
 {
 	m_isSimulationRunning = true;
-	m_world = P2World{ 980 };
-	m_linesInWorld.clear();
+	m_simulationStepCount = 0;
 	m_startBallsInWorld.clear();
 
-	if (isQueriesInitialState()) {
+	// 全クエリの実行（パス）の先頭でだけ初期配置を組み立て直す
+	const bool isNewPass = isQueriesInitialState();
+	if (isNewPass) {
 
 
 		m_initialLines.clear();
@@ -355,7 +676,7 @@ void Stage::startSimulation()
 
 
 		// 壁（エッジ）を物理世界に追加
-		for (const auto& edge : m_edges) {
+		for (const auto& [id, edge] : m_edges) {
 			const Vec2& p1 = m_points.at(edge[0]);
 			const Vec2& p2 = m_points.at(edge[1]);
 			Line line(p1, p2);
@@ -370,7 +691,7 @@ void Stage::startSimulation()
 		// プレイヤーが配置したボールを物理世界に追加
 		// 種類ごとに maxCount を超えないようにカウント
 		HashTable<BallKind, int32> kindCounts;
-		for (const auto& placedBall : m_placedBalls) {
+		for (const auto& [id, placedBall] : m_placedBalls) {
 			if (placedBall.isLocked) {
 				m_initialBalls.push_back(placedBall);
 				//P2Body ballBody = createCircle(m_world, P2Dynamic, Circle(placedBall.center, GetBallRadius(placedBall.kind)));
@@ -397,9 +718,25 @@ void Stage::startSimulation()
 
 	}
 
-	for (const auto& line : m_initialLines) {
-		auto lineBody = createLine(m_world, P2Static, line);
-		m_linesInWorld.push_back(lineBody);
+	// 壁は m_initialLines が変わらない限り同じなので、パスの途中では前のクエリの剛体をそのまま使う
+	if (isNewPass || not m_reuseStaticBodies || not m_hasStaticBodies) {
+		m_linesInWorld.clear();
+		m_world = P2World{ 980 };
+		if (m_mergeConnectedLines) {
+			for (const auto& chain : BuildLineChains(m_initialLines)) {
+				auto chainBody = (chain.size() == 2)
+					? createLine(m_world, P2Static, Line{ chain[0], chain[1] })
+					: createLineString(m_world, P2Static, chain);
+				m_linesInWorld.push_back(chainBody);
+			}
+		}
+		else {
+			for (const auto& line : m_initialLines) {
+				auto lineBody = createLine(m_world, P2Static, line);
+				m_linesInWorld.push_back(lineBody);
+			}
+		}
+		m_hasStaticBodies = true;
 	}
 
 	for (const auto& circle : m_initialBalls) {
@@ -408,15 +745,31 @@ void Stage::startSimulation()
 	}
 	
 	// クエリ固有のシミュレーション開始処理
+	m_queryRunState = QueryRunState{};
 	if (m_currentQueryIndex < m_queries->size()) {
-		(*m_queries)[m_currentQueryIndex]->startSimulation(*this);
+		(*m_queries)[m_currentQueryIndex]->startSimulation(*this, m_queryRunState);
+	}
+
+	// ゴール判定用のインデックスを構築し、初期配置のボールを登録
+	m_goalAreaIndex = GoalAreaIndex{ m_goalAreas };
+	for (auto& ball : m_startBallsInWorld) {
+		m_goalAreaIndex.updateBall(ball);
+	}
+
+	// 軌跡の記録を開始（以前の同じクエリの記録は捨てる）
+	if (m_isTrajectoryRecordingEnabled && m_currentQueryIndex < m_queries->size()) {
+		if (m_trajectoryRecordings.size() != m_queries->size()) {
+			m_trajectoryRecordings.resize(m_queries->size());
+		}
+		m_trajectoryRecordings[m_currentQueryIndex] = TrajectoryRecording{ m_trajectoryMaxSeconds };
+		recordTrajectory();
 	}
 }
 
 bool Stage::checkSimulationResult() const
 {
 	if (m_currentQueryIndex < m_queries->size()) {
-		return (*m_queries)[m_currentQueryIndex]->checkSimulationResult(*this);
+		return (*m_queries)[m_currentQueryIndex]->checkSimulationResult(*this, m_queryRunState);
 	}
 	return false;
 }
@@ -424,8 +777,12 @@ bool Stage::checkSimulationResult() const
 void Stage::endSimulation()
 {
 	m_startBallsInWorld.clear();
-	m_linesInWorld.clear();
-	m_world = P2World{};
+	m_goalAreaIndex = GoalAreaIndex{};
+	if (not m_reuseStaticBodies) {
+		m_linesInWorld.clear();
+		m_world = P2World{};
+		m_hasStaticBodies = false;
+	}
 	m_simulationTimeAccumlate = 0.0;
 	m_isSimulationRunning = false;
 	m_isSimulationPaused = false;
@@ -434,29 +791,158 @@ void Stage::endSimulation()
 
 double Stage::getLowestY() const
 {
-	double lowestY = -Inf<double>;
+	if (const auto bounds = getBounds()) {
+		return bounds->bottomY();
+	}
+	return -Inf<double>;
+}
+
+Optional<RectF> Stage::getBounds() const
+{
+	if (m_isBoundsDirty) {
+		m_bounds = calculateBounds();
+		m_isBoundsDirty = false;
+	}
+	return m_bounds;
+}
+
+void Stage::expandBounds(const RectF& rect)
+{
+	// 無効化されていれば次の参照で全体を再計算するので何もしない
+	if (m_isBoundsDirty) {
+		return;
+	}
+
+	if (not m_bounds) {
+		m_bounds = rect;
+		return;
+	}
+
+	const Vec2 tl{ Min(m_bounds->x, rect.x), Min(m_bounds->y, rect.y) };
+	const Vec2 br{ Max(m_bounds->rightX(), rect.rightX()), Max(m_bounds->bottomY(), rect.bottomY()) };
+	m_bounds = RectF{ tl, br - tl };
+}
+
+Optional<RectF> Stage::calculateBounds() const
+{
+	double left = Inf<double>, top = Inf<double>;
+	double right = -Inf<double>, bottom = -Inf<double>;
+	auto expand = [&](const RectF& r) {
+		left = Min(left, r.x);
+		top = Min(top, r.y);
+		right = Max(right, r.rightX());
+		bottom = Max(bottom, r.bottomY());
+	};
 	
 	// Points (Edges の頂点)
 	for (const auto& [id, pos] : m_points) {
-		lowestY = Max(lowestY, pos.y);
+		expand(RectF{ pos, 0, 0 });
 	}
 	
 	// StartCircles
 	for (const auto& c : m_startCircles) {
-		lowestY = Max(lowestY, c.circle.center.y + c.circle.r);
+		expand(c.circle.boundingRect());
 	}
 	
 	// GoalAreas
 	for (const auto& g : m_goalAreas) {
-		lowestY = Max(lowestY, g.rect.br().y);
+		expand(g.rect);
 	}
 	
 	// PlacedBalls
-	for (const auto& b : m_placedBalls) {
-		lowestY = Max(lowestY, b.center.y + GetBallRadius(b.kind));
+	for (const auto& [id, b] : m_placedBalls) {
+		expand(Circle{ b.center, GetBallRadius(b.kind) }.boundingRect());
 	}
 	
-	return lowestY;
+	if (left > right) {
+		return none;
+	}
+	return RectF{ left, top, right - left, bottom - top };
+}
+
+Array<int32> Stage::pickCandidates(const Vec2& pos, double margin) const
+{
+	if (m_isPickGridDirty) {
+		m_pickGrid.clear();
+		m_isPickGridDirty = false;
+		for (int32 i = 0; i < m_layerOrder.size(); ++i) {
+			insertToPickGrid(i);
+		}
+	}
+	AssertCacheInSync(m_pickGrid.size() == m_layerOrder.size(), U"LayerPickGrid");
+	return m_pickGrid.query(pos, margin);
+}
+
+void Stage::insertToPickGrid(int32 layerPos) const
+{
+	// 無効化されていれば次の参照で全体を作り直すので何もしない
+	if (m_isPickGridDirty) {
+		return;
+	}
+
+	const auto& obj = m_layerOrder[layerPos];
+	switch (obj.type) {
+	case LayerObjectType::Edge: {
+		const auto& edge = m_edges[obj.id];
+		m_pickGrid.insertLine(layerPos, Line{ m_points.at(edge[0]), m_points.at(edge[1]) });
+		break;
+	}
+	case LayerObjectType::StartCircle:
+		m_pickGrid.insert(layerPos, m_startCircles[obj.id].circle.boundingRect());
+		break;
+	case LayerObjectType::GoalArea:
+		m_pickGrid.insert(layerPos, m_goalAreas[obj.id].rect);
+		break;
+	case LayerObjectType::PlacedBall: {
+		const auto& ball = m_placedBalls[obj.id];
+		m_pickGrid.insert(layerPos, Circle{ ball.center, GetBallRadius(ball.kind) }.boundingRect());
+		break;
+	}
+	}
+}
+
+bool Stage::containsEdgeSegment(const EdgeSegment& segment) const
+{
+	if (m_isEdgeSegmentSetDirty) {
+		m_edgeSegmentSet.clear();
+		m_isEdgeSegmentSetDirty = false;
+		for (const auto& [edgeId, edge] : m_edges) {
+			insertToEdgeSegmentSet(edgeId);
+		}
+	}
+	AssertCacheInSync(m_edgeSegmentSet.edgeCount == m_edges.size(), U"EdgeSegmentSet");
+	return m_edgeSegmentSet.contains(segment);
+}
+
+void Stage::insertToEdgeSegmentSet(int32 edgeIndex) const
+{
+	// 無効化されていれば次の参照で全体を作り直すので何もしない
+	if (m_isEdgeSegmentSetDirty) {
+		return;
+	}
+	const auto& edge = m_edges[edgeIndex];
+	m_edgeSegmentSet.add(EdgeSegment{ m_points.at(edge[0]), m_points.at(edge[1]) });
+}
+
+void Stage::recordTrajectory()
+{
+	if (m_isTrajectoryRecordingEnabled && m_currentQueryIndex < m_trajectoryRecordings.size()) {
+		m_trajectoryRecordings[m_currentQueryIndex].record(m_startBallsInWorld);
+	}
+}
+
+bool Stage::hasTrajectoryRecording() const
+{
+	return m_trajectoryRecordings.any([](const TrajectoryRecording& r) { return not r.isEmpty(); });
+}
+
+size_t Stage::trajectoryMemoryUsage() const
+{
+	size_t bytes = 0;
+	for (const auto& recording : m_trajectoryRecordings) {
+		bytes += recording.memoryUsage();
+	}
+	return bytes;
 }
 
 void Stage::addInventorySlot(BallKind ballKind, Optional<int32> maxCount)
@@ -500,6 +986,7 @@ void Stage::resetQueryProgress()
 	m_queryCompleted.assign(m_queries->size(), false);
 	m_queryFailed.assign(m_queries->size(), false);
 	m_currentQueryIndex = 0;
+	m_trajectoryRecordings.clear();
 	// m_isCleared = false;
 }
 
@@ -543,32 +1030,38 @@ bool Stage::isQueriesInitialState() const
 	return true;
 }
 
-StageSnapshot Stage::createSnapshot() const
+StageSnapshot Stage::createSnapshot(const StageSnapshot* base) const
 {
+	// 比較は複製よりずっと安いので、要素ごとに直前と比べて変わったものだけ複製する
 	return StageSnapshot{
-		.points = m_points,
-		.nextPointId = m_nextPointId,
-		.edges = m_edges,
-		.groups = m_groups,
+		.points = ShareIfUnchanged(base ? base->points : nullptr, m_points),
+		.edges = ShareIfUnchanged(base ? base->edges : nullptr, m_edges),
+		.groups = ShareIfUnchanged(base ? base->groups : nullptr, m_groups),
 		.nextGroupId = m_nextGroupId,
-		.placedBalls = m_placedBalls,
-		.inventorySlots = m_inventorySlots,
-		.layerOrder = m_layerOrder,
-		.nonEditableAreas = m_nonEditableAreas
+		.placedBalls = ShareIfUnchanged(base ? base->placedBalls : nullptr, m_placedBalls),
+		.inventorySlots = ShareIfUnchanged(base ? base->inventorySlots : nullptr, m_inventorySlots),
+		.layerOrder = ShareIfUnchanged(base ? base->layerOrder : nullptr, m_layerOrder),
+		.nonEditableAreas = ShareIfUnchanged(base ? base->nonEditableAreas : nullptr, m_nonEditableAreas),
+		.scoreCounters = scoreCounters()
 	};
 }
 
 void Stage::restoreSnapshot(const StageSnapshot& snapshot)
 {
-	m_points = snapshot.points;
-	m_nextPointId = snapshot.nextPointId;
-	m_edges = snapshot.edges;
-	m_groups = snapshot.groups;
+	m_points = *snapshot.points;
+	m_edges = *snapshot.edges;
+	m_groups = *snapshot.groups;
 	m_nextGroupId = snapshot.nextGroupId;
-	m_placedBalls = snapshot.placedBalls;
-	m_inventorySlots = snapshot.inventorySlots;
-	m_layerOrder = snapshot.layerOrder;
-	m_nonEditableAreas = snapshot.nonEditableAreas;
+	m_placedBalls = *snapshot.placedBalls;
+	m_inventorySlots = *snapshot.inventorySlots;
+	m_layerOrder = *snapshot.layerOrder;
+	m_nonEditableAreas = *snapshot.nonEditableAreas;
+	m_isNonEditableAreaIndexDirty = true;
+	m_scoreCounters = snapshot.scoreCounters;
+	m_isScoreCountersDirty = false;
+	invalidateSpatialCaches();
+	invalidateGroupArena();
+	invalidateIncidentEdgeIndex();
 }
 
 PointEdgeGroup Stage::getAllSelectableObjectsAsPointEdgeGroup() const
@@ -582,10 +1075,36 @@ PointEdgeGroup Stage::getAllSelectableObjectsAsPointEdgeGroup() const
 
 void Stage::removeAllSelectableObjects()
 {
-	// すべてのオブジェクトを選択状態にしてから削除
-	SelectedIDSet allSelectedIDs;
-	allSelectedIDs.selectAllObjects(*this);
-	eraseSelectedPoints(allSelectedIDs.m_ids);
+	// selectAllObjects で選ばれるもの（ロックされていないもの）を、選択を作らずに直接まとめて削除
+	Array<bool> pointMarks(m_points.slotCount(), false);
+	for (const auto& [pointId, pos] : m_points) {
+		pointMarks[pointId] = true;
+	}
+	for (const auto& [edgeId, edge] : m_edges) {
+		if (edge.isLocked) {
+			pointMarks[edge[0]] = false;
+			pointMarks[edge[1]] = false;
+		}
+	}
+
+	Array<bool> placedBallMarks(m_placedBalls.slotCount(), false);
+	for (const auto& [ballId, ball] : m_placedBalls) {
+		placedBallMarks[ballId] = not ball.isLocked;
+	}
+
+	Array<int32> unlockedGroupIds;
+	for (const auto& [groupId, group] : m_groups) {
+		if (group.isLocked) continue;
+		unlockedGroupIds.push_back(groupId);
+		const auto members = groupMembers(groupId);
+		for (auto pid : members.pointIds) pointMarks[pid] = true;
+		for (auto bid : members.placedBallIds) placedBallMarks[bid] = true;
+	}
+	for (auto groupId : unlockedGroupIds) {
+		m_groups.erase(groupId);
+	}
+
+	eraseMarkedObjects(pointMarks, placedBallMarks);
 }
 
 void Stage::pastePointEdgeGroup(const PointEdgeGroup& m_clipboard, SelectedIDSet& selectedIDs)
@@ -595,9 +1114,8 @@ void Stage::pastePointEdgeGroup(const PointEdgeGroup& m_clipboard, SelectedIDSet
 	HashSet<int32> usedNewPointIds;
 	HashSet<int32> usedOldPointIds;
 	for (const auto& [oldPointId, pos] : m_clipboard.m_points) {
-		int32 newPointId = m_nextPointId++;
+		const int32 newPointId = m_points.insert(pos);
 		pointIdMapping[oldPointId] = newPointId;
-		m_points[newPointId] = pos;
 		newSelectedPointIds.insert(newPointId);
 	}
 	for (const auto& edge : m_clipboard.m_edges) {
@@ -608,9 +1126,14 @@ void Stage::pastePointEdgeGroup(const PointEdgeGroup& m_clipboard, SelectedIDSet
 			continue;
 		}
 		Edge newEdge = { { pointIdMapping.at(edge[0]), pointIdMapping.at(edge[1]) } };
-		int32 edgeIndex = m_edges.size();
-		m_edges.push_back(newEdge);
+		const int32 edgeIndex = m_edges.insert(newEdge);
 		m_layerOrder.push_back(LayerObject{ LayerObjectType::Edge, edgeIndex });
+		touchEditGeneration();
+		m_isAreaSelectIndexDirty = true;
+		insertToPickGrid(m_layerOrder.size() - 1);
+		insertToIncidentEdgeIndex(edgeIndex);
+		insertToEdgeSegmentSet(edgeIndex);
+		addEdgeToScore(edgeIndex);
 		usedNewPointIds.insert(pointIdMapping.at(edge[0]));
 		usedNewPointIds.insert(pointIdMapping.at(edge[1]));
 		usedOldPointIds.insert(edge[0]);
@@ -623,6 +1146,9 @@ void Stage::pastePointEdgeGroup(const PointEdgeGroup& m_clipboard, SelectedIDSet
 			newSelectedPointIds.erase(newPointId);
 		}
 	}
+	for (auto pointId : usedNewPointIds) {
+		expandBounds(RectF{ m_points.at(pointId), 0, 0 });
+	}
 	for (const auto& group : m_clipboard.m_groups) {
 		// エッジ制限で消えたポイントを含むグループはスキップ
 		bool ok = true;
@@ -657,8 +1183,8 @@ void Stage::pastePointEdgeGroup(const PointEdgeGroup& m_clipboard, SelectedIDSet
 
 		// 配置可能な場合のみステージに追加
 		if (canPlace) {
-			addPlacedBall(placedBall);
-			sel.insert(SelectedID{ SelectType::PlacedBall, static_cast<int32>(m_placedBalls.size()) - 1 });
+			const int32 placedBallId = addPlacedBall(placedBall);
+			sel.insert(SelectedID{ SelectType::PlacedBall, placedBallId });
 		}
 	}
 
@@ -667,12 +1193,10 @@ void Stage::pastePointEdgeGroup(const PointEdgeGroup& m_clipboard, SelectedIDSet
 
 bool Stage::isPointInNonEditableArea(const Vec2& pos) const
 {
-	for (const auto& r : m_nonEditableAreas) {
-		if (r.contains(pos)) {
-			return true;
-		}
+	if (m_nonEditableAreas.empty()) {
+		return false;
 	}
-	return false;
+	return nonEditableAreaIndex().containsPoint(pos);
 }
 
 bool Stage::isLineAllowedInEditableArea(const Line& line) const
@@ -680,18 +1204,25 @@ bool Stage::isLineAllowedInEditableArea(const Line& line) const
 	if (m_nonEditableAreas.empty()) {
 		return true;
 	}
+	return nonEditableAreaIndex().isLineAllowed(line);
+}
 
-	if (isPointInNonEditableArea(line.begin) || isPointInNonEditableArea(line.end)) {
-		return false;
+bool Stage::areLinesAllowedInEditableArea(const Array<Line>& lines) const
+{
+	if (m_nonEditableAreas.empty()) {
+		return true;
 	}
+	return nonEditableAreaIndex().areLinesAllowed(lines);
+}
 
-	for (const auto& rect : m_nonEditableAreas) {
-		if (rect.intersects(line)) {
-			return false;
-		}
+const NonEditableAreaIndex& Stage::nonEditableAreaIndex() const
+{
+	if (m_isNonEditableAreaIndexDirty) {
+		m_nonEditableAreaIndex = NonEditableAreaIndex{ m_nonEditableAreas };
+		m_isNonEditableAreaIndexDirty = false;
 	}
-
-	return true;
+	AssertCacheInSync(m_nonEditableAreaIndex.areaCount() == m_nonEditableAreas.size(), U"NonEditableAreaIndex");
+	return m_nonEditableAreaIndex;
 }
 
 
@@ -759,8 +1290,9 @@ int32 Stage::CalculateNumberOfObjects() const
 
 int32 Stage::CalculateTotalLength() const
 {
+	// 送信するスコアなので、登録済みの記録と同じく長さをそのまま足してから切り捨てる
 	double sum = 0;
-	for (const auto& edge : m_edges) {
+	for (const auto& [edgeId, edge] : m_edges) {
 		if (!edge.isLocked)
 		{
 			const Vec2& p1 = m_points.at(edge[0]);
@@ -771,18 +1303,80 @@ int32 Stage::CalculateTotalLength() const
 	return sum;
 }
 
+const ScoreCounters& Stage::scoreCounters() const
+{
+	if (m_isScoreCountersDirty) {
+		m_scoreCounters = computeScoreCounters();
+		m_isScoreCountersDirty = false;
+	}
+	AssertCacheInSync(m_scoreCounters.edgeCount == m_edges.size() && m_scoreCounters.placedBallCount == m_placedBalls.size(), U"ScoreCounters");
+	return m_scoreCounters;
+}
+
+ScoreCounters Stage::computeScoreCounters() const
+{
+	ScoreCounters counters;
+	counters.edgeCount = static_cast<int32>(m_edges.size());
+	counters.placedBallCount = static_cast<int32>(m_placedBalls.size());
+	for (const auto& [edgeId, edge] : m_edges) {
+		if (!edge.isLocked) {
+			++counters.unlockedEdgeCount;
+			counters.totalLengthUnits += ScoreCounters::LengthUnits(m_points.at(edge[0]), m_points.at(edge[1]));
+		}
+	}
+	counters.unlockedPlacedBallCount = static_cast<int32>(m_placedBalls.count_if([](const PlacedBall& ball) { return !ball.isLocked; }));
+	return counters;
+}
+
+void Stage::addEdgeToScore(int32 edgeIndex) const
+{
+	// 無効化されていれば次の参照で全体を集計し直すので何もしない
+	if (m_isScoreCountersDirty) {
+		return;
+	}
+	const auto& edge = m_edges[edgeIndex];
+	if (!edge.isLocked) {
+		++m_scoreCounters.unlockedEdgeCount;
+		m_scoreCounters.totalLengthUnits += ScoreCounters::LengthUnits(m_points.at(edge[0]), m_points.at(edge[1]));
+	}
+	++m_scoreCounters.edgeCount;
+}
+
+void Stage::addPlacedBallToScore(int32 index) const
+{
+	if (m_isScoreCountersDirty) {
+		return;
+	}
+	if (!m_placedBalls[index].isLocked) {
+		++m_scoreCounters.unlockedPlacedBallCount;
+	}
+	++m_scoreCounters.placedBallCount;
+}
+
+void Stage::addToScoreLength(int64 deltaUnits) const
+{
+	if (not m_isScoreCountersDirty) {
+		m_scoreCounters.totalLengthUnits += deltaUnits;
+	}
+}
+
 void Stage::restoreRecord(const StageRecord& record)
 {
 	m_name = record.m_stageName;
-	m_points = record.m_points;
-	m_edges = record.m_edges;
+	m_points = PointTable{ record.m_points };
+	m_edges = SlotTable<Edge>{ record.m_edges };
 	m_groups = record.m_groups;
 	m_startCircles = record.m_startCircles;
 	m_goalAreas = record.m_goalAreas;
-	m_placedBalls = record.m_placedBalls;
+	m_placedBalls = SlotTable<PlacedBall>{ record.m_placedBalls };
 	m_nonEditableAreas = record.m_nonEditableAreas;
+	m_isNonEditableAreaIndexDirty = true;
 	m_inventorySlots = record.m_inventorySlots;
 	m_layerOrder = record.m_layerOrder;
+	invalidateSpatialCaches();
+	invalidateScoreCounters();
+	invalidateGroupArena();
+	invalidateIncidentEdgeIndex();
 }
 
 # include ".SECRET"
@@ -791,15 +1385,26 @@ StageRecord::StageRecord(const Stage& stage, String author)
 {
 	m_stageName = stage.m_name;
 	m_author = author;
-	m_points = stage.m_points;
-	m_edges = stage.m_edges;
-	m_groups = stage.m_groups;
+	m_points = stage.m_points.toHashTable();
 	m_startCircles = stage.m_startCircles;
 	m_goalAreas = stage.m_goalAreas;
-	m_placedBalls = stage.m_placedBalls;
 	m_nonEditableAreas = stage.m_nonEditableAreas;
 	m_inventorySlots = stage.m_inventorySlots;
+
+	// エッジと配置ボールは空きスロットを詰め、それらを指す ID を詰めた後の添字に付け替える
+	Array<int32> edgeIndexOfId, placedBallIndexOfId;
+	m_edges = stage.m_edges.toArray(&edgeIndexOfId);
+	m_placedBalls = stage.m_placedBalls.toArray(&placedBallIndexOfId);
 	m_layerOrder = stage.m_layerOrder;
+	for (auto& obj : m_layerOrder) {
+		if (obj.type == LayerObjectType::Edge) obj.id = edgeIndexOfId[obj.id];
+		else if (obj.type == LayerObjectType::PlacedBall) obj.id = placedBallIndexOfId[obj.id];
+	}
+	m_groups = stage.m_groups;
+	for (auto& [groupId, group] : m_groups) {
+		RemapPlacedBallIds(group, placedBallIndexOfId);
+	}
+
 	m_numberOfObjects = stage.CalculateNumberOfObjects();
 	m_totalLength = stage.CalculateTotalLength();
 }
@@ -827,6 +1432,30 @@ void StageRecord::fromBlobStr()
 	{
 		archive(m_points, m_edges, m_groups, m_startCircles, m_goalAreas, m_placedBalls, m_nonEditableAreas, m_inventorySlots, m_layerOrder);
 	}
+
+	// 受け取ったデータの ID が範囲外だと復元時に配列の外を触るので、ここで弾く（fromJSON で無効な記録として捨てられる）
+	for (const auto& [id, pos] : m_points) {
+		if (not PointTable::IsValidId(id)) throw std::out_of_range("StageRecord: invalid point id");
+	}
+	if (SlotTable<Edge>::MaxSlotCount < m_edges.size() || SlotTable<PlacedBall>::MaxSlotCount < m_placedBalls.size()) {
+		throw std::length_error("StageRecord: too many objects");
+	}
+	for (const auto& edge : m_edges) {
+		if (not m_points.contains(edge[0]) || not m_points.contains(edge[1])) throw std::out_of_range("StageRecord: invalid edge");
+	}
+	for (const auto& obj : m_layerOrder) {
+		size_t count = 0;
+		switch (obj.type) {
+		case LayerObjectType::Edge: count = m_edges.size(); break;
+		case LayerObjectType::PlacedBall: count = m_placedBalls.size(); break;
+		case LayerObjectType::StartCircle: count = m_startCircles.size(); break;
+		case LayerObjectType::GoalArea: count = m_goalAreas.size(); break;
+		}
+		if (obj.id < 0 || count <= static_cast<size_t>(obj.id)) throw std::out_of_range("StageRecord: invalid layer object");
+	}
+	for (const auto& [groupId, group] : m_groups) {
+		if (not HasValidMemberIds(group, *this)) throw std::out_of_range("StageRecord: invalid group");
+	}
 }
 
 void StageRecord::calculateHash()
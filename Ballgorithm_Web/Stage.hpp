@@ -5,21 +5,52 @@
 # include "Domain.hpp"
 # include "GeometryUtils.hpp"
 # include "Query.hpp"
+# include "TrajectoryRecording.hpp"
+# include "GoalAreaIndex.hpp"
+# include "LayerPickGrid.hpp"
+# include "PointTable.hpp"
+# include "NonEditableAreaIndex.hpp"
+# include "AreaSelectIndex.hpp"
 # include "Inventory.h"
 
 class Game;
 
+// リーダーボードのスコアの集計（ロックされていないエッジとボールだけを数える）
+struct ScoreCounters {
+	int32 unlockedEdgeCount = 0;
+	int32 unlockedPlacedBallCount = 0;
+	int64 totalLengthUnits = 0;  // ロックされていないエッジの長さの合計（LengthUnitsPerPixel 分の1単位の固定小数点。足し引きで誤差がたまらない）
+	int32 edgeCount = 0;        // 集計したときの m_edges.size()（無効化漏れの検出用）
+	int32 placedBallCount = 0;  // 集計したときの m_placedBalls.size()
+
+	int32 numberOfObjects() const { return unlockedEdgeCount + unlockedPlacedBallCount; }
+	int32 totalLengthScore() const { return static_cast<int32>(totalLengthUnits / LengthUnitsPerPixel); }  // 編集中の表示用（送信するスコアは CalculateTotalLength）
+
+	static constexpr int64 LengthUnitsPerPixel = 1'000'000;
+	// 1本のエッジの長さを固定小数点にする（エッジごとに丸めるので、合計は足す順序によらない）
+	static int64 LengthUnits(const Vec2& p1, const Vec2& p2) { return static_cast<int64>(Math::Round(p1.distanceFrom(p2) * LengthUnitsPerPixel)); }
+};
+
 // Undo/Redo用のステージスナップショット
+// 各要素は共有して持ち、直前のスナップショットと内容が同じ要素は複製せずに同じものを指す
+// （1回の編集で増えるのは変わった要素のぶんだけ）
 struct StageSnapshot {
-	HashTable<int32, Vec2> points;
-	int32 nextPointId;
-	Array<Edge> edges;
-	HashTable<int32, Group> groups;
+	std::shared_ptr<const PointTable> points;
+	std::shared_ptr<const SlotTable<Edge>> edges;
+	std::shared_ptr<const HashTable<int32, Group>> groups;
 	int32 nextGroupId;
-	Array<PlacedBall> placedBalls;
-	Array<InventorySlot> inventorySlots;
-	Array<LayerObject> layerOrder;
-	Array<RectF> nonEditableAreas;
+	std::shared_ptr<const SlotTable<PlacedBall>> placedBalls;
+	std::shared_ptr<const Array<InventorySlot>> inventorySlots;
+	std::shared_ptr<const Array<LayerObject>> layerOrder;
+	std::shared_ptr<const Array<RectF>> nonEditableAreas;
+	ScoreCounters scoreCounters;
+
+	// 概算のメモリ使用量（counted に入っている要素は他のスナップショットと共有済みとして数えない）
+	size_t memoryUsage(HashSet<const void*>& counted) const;
+
+	// このスナップショットだけが持っている要素の概算バイト数（use_count() が 1 の要素）
+	// 作ったばかりなら今回増えたぶん、捨てる直前なら解放されるぶんになる
+	size_t exclusiveMemoryUsage() const;
 };
 
 class StageSave
@@ -43,6 +74,7 @@ class StageRecord
 public:
 	String m_stageName;
 
+	// 送信形式。エッジと配置ボールは詰めた配列で持ち、レイヤー順序・グループの ID はその添字（点は ID のまま）
 	HashTable<int32, Vec2> m_points;
 	Array<Edge> m_edges;
 	HashTable<int32, Group> m_groups;
@@ -90,14 +122,18 @@ public:
 	Array<String> m_tutorialTexts;
 
 	// ステージ固有データ
-	HashTable<int32, Vec2> m_points;
-	int32 m_nextPointId = 0;
-	Array<Edge> m_edges;
+	// 点・エッジ・配置ボールは ID を添字にした表に置く。削除しても他の ID は変わらないので、
+	// レイヤー順序とグループは削除されたものを外すだけでよい（削除した ID は次の追加で使い回す）
+	// 走査は追加した順なので、シミュレーションの剛体の作成順は配列で持っていたときと変わらない
+	// 編集をまたいで ID を持つ側（ホバー・ドラッグ・キャッシュのキー）は世代や version() で使い回しを見分ける
+	// StartCircle と GoalArea はステージの構築後に増減しないので添字のまま
+	PointTable m_points;  // 点ID → 座標
+	SlotTable<Edge> m_edges;  // エッジID → エッジ
 	HashTable<int32, Group> m_groups;
 	int32 m_nextGroupId = 0;
 	Array<StartCircle> m_startCircles;
 	Array<GoalArea> m_goalAreas;
-	Array<PlacedBall> m_placedBalls; // プレイヤーが配置したボール
+	SlotTable<PlacedBall> m_placedBalls; // プレイヤーが配置したボール（ID → ボール）
 	
 	// 編集不可エリア（UI操作で線を作れない/貫通できない領域）
 	Array<RectF> m_nonEditableAreas;
@@ -110,29 +146,75 @@ public:
 	
 	P2World m_world;
 	Array<P2Body> m_linesInWorld;
+	bool m_reuseStaticBodies = false;  // パス中は endSimulation でボールだけを消し、壁の剛体を次のクエリで使い回す（接触の順序が新しいワールドと変わり得るので、ヘッドレス検証でだけ使う）
+	bool m_hasStaticBodies = false;   // m_world に m_initialLines の壁が入っているか
+	bool m_mergeConnectedLines = false;  // 端点を共有して連なる壁を1つの剛体にまとめる（剛体数の削減）
 	Array<Ball> m_startBallsInWorld;
 	Array<Line> m_initialLines;
 	Array<PlacedBall> m_initialBalls;
 	double m_simulationTimeAccumlate = 0.0;
 	static constexpr double simulationTimeStep = 1.0 / 60.0;
+	int32 m_simulationStepCount = 0;  // 現在のクエリ開始からの固定ステップ数
 	bool m_isSimulationRunning = false;
 	bool m_isSimulationPaused = false;
 	double m_simulationSpeed = 1.0;  // 1.0 = 通常速度, 2.0以上 = 早送り
 	std::shared_ptr<Array<std::unique_ptr<IQuery>>> m_queries = std::make_shared<Array<std::unique_ptr<IQuery>>>();
 	int32 m_currentQueryIndex = 0;
+	QueryRunState m_queryRunState;  // 実行中のクエリの進行状態（クエリ定義は他のステージと共有してよい）
+	GoalAreaIndex m_goalAreaIndex;  // 実行中のゴール判定用（startSimulation で構築）
+
+	// 軌跡の記録（クエリごとに最後の実行ぶんを保持し、リプレイで使う）
+	Array<TrajectoryRecording> m_trajectoryRecordings;
+	double m_trajectoryMaxSeconds = 60.0;   // 1クエリあたり記録する秒数の上限
+	bool m_isTrajectoryRecordingEnabled = true;
 	
 	// クエリ達成状況
 	Array<bool> m_queryCompleted;
 	Array<bool> m_queryFailed;  // クエリ失敗状況
 	bool m_isCleared = false;
 
+	// 以下のキャッシュは、書き換えるたびに差分更新するか無効化する（数のずれを見て作り直すことはしない。DEBUG ビルドでは照合して止める）
+	// getBounds() と pickCandidates() のキャッシュ（ステージを直接書き換えたら invalidateSpatialCaches() を呼ぶこと）
+	mutable Optional<RectF> m_bounds;
+	mutable bool m_isBoundsDirty = true;
+	mutable LayerPickGrid m_pickGrid;
+	mutable bool m_isPickGridDirty = true;
+
+	// グループの木を平らにした表（グループ化・解除では差分更新、削除・復元では作り直す）
+	// findTopGroup* の逆引きも、範囲選択のグループの外接矩形もここから作る（m_groups から派生させるのはこれだけ）
+	mutable GroupArena m_groupArena;
+	mutable bool m_isGroupArenaDirty = true;
+
+	// 範囲選択用の索引（追加・形が変わったら無効化する。グループの構成は m_groupArena の版で見分ける）
+	mutable AreaSelectIndex m_areaSelectIndex;
+	mutable bool m_isAreaSelectIndexDirty = true;
+
+	// 点 → 接続エッジの索引（追加・貼り付けでは差分更新、削除・復元では作り直す）
+	mutable IncidentEdgeIndex m_incidentEdgeIndex;
+	mutable bool m_isIncidentEdgeIndexDirty = true;
+
+	// エッジの線分の集合（追加・貼り付けでは差分更新、形が変わったら作り直す）
+	mutable EdgeSegmentSet m_edgeSegmentSet;
+	mutable bool m_isEdgeSegmentSetDirty = true;
+
+	// 編集不可エリアの索引（エリアを追加・差し替えたら作り直す）
+	mutable NonEditableAreaIndex m_nonEditableAreaIndex;
+	mutable bool m_isNonEditableAreaIndexDirty = true;
+
+	// スコアの集計（追加・削除・貼り付け・ドラッグでは差分更新、Undo ではスナップショットから戻す）
+	mutable ScoreCounters m_scoreCounters;
+	mutable bool m_isScoreCountersDirty = true;
+
+	// 編集世代（追加・invalidateSpatialCaches()・invalidatePickGrid() で進む）
+	mutable uint64 m_editGeneration = 0;
+
 	// カメラ位置（ステージごとに保持）
 	Vec2 m_cameraCenter{ 400, 300 };
 	double m_cameraScale = 1.0;
 
 	Stage();
 
-	// 各オブジェクトを追加し、追加されたエッジ/オブジェクトのインデックスを返す
+	// 各オブジェクトを追加し、追加されたエッジ/オブジェクトの ID を返す
 	int32 addLine(const Line& line, bool isLocked = false);
 	int32 addStartCircle(const StartCircle& startCircle);
 	int32 addGoalArea(const GoalArea& goalArea);
@@ -146,10 +228,9 @@ public:
 	
 	void bringToFront(LayerObject obj);
 	void removeFromLayerOrder(LayerObject obj);
-	void updateLayerOrderAfterRemoval(LayerObjectType type, int32 removedId);
-	void removePlacedBall(int32 index);  // PlacedBallを削除し、レイヤー順序も更新
+	void removePlacedBall(int32 id);  // グループに属さないPlacedBallを削除し、レイヤー順序からも外す
 	
-	void createGroup(const Group& group);
+	void createGroup(Group group);
 	int32 createLockedGroup(const Group& group);  // isLocked=trueでグループ作成、IDを返す
 	void createGroupFromSelection(HashSet<SelectedID>& selectedIDs);
 	void ungroup(int32 groupId);
@@ -158,15 +239,61 @@ public:
 	Optional<int32> findTopGroupForPlacedBall(int32 placedBallId) const;
 	Optional<int32> findTopGroupForStartCircle(int32 startCircleId) const;
 	Optional<int32> findTopGroupForGoalArea(int32 goalAreaId) const;
+	// グループの構成が変わったら呼ぶ（平らにした表を作り直す。逆引きと範囲選択の外接矩形もそれに従う）
+	void invalidateGroupArena() const { m_isGroupArenaDirty = true; }
+
+	// トップレベルのグループの中身（入れ子を含む）。ステージを書き換えるまでの間だけ有効
+	GroupMembers groupMembers(int32 groupId) const { return groupArena().membersOf(groupId); }
+	const GroupArena& groupArena() const;
+
+	// pointId を端点に持つエッジのインデックス
+	const Array<int32>& incidentEdges(int32 pointId) const;
+	const IncidentEdgeIndex& incidentEdgeIndex() const;
+	void invalidateIncidentEdgeIndex() const { m_isIncidentEdgeIndexDirty = true; }
+	void insertToIncidentEdgeIndex(int32 edgeIndex) const;
 	Group mapGroupIDs(const Group& group, const HashTable<int32, int32>& idMapping) const;
 	PointEdgeGroup copySelectedObjects(const HashSet<SelectedID>& selectedIDs) const;
 	void deltaMoveGroup(const Group& group, const Vec2& deltaMove);
 	void eraseSelectedPoints(const HashSet<SelectedID>& selectedIDs);
+	// 印を付けた点（ID で添字）・PlacedBall と、それにつながるエッジを1回の詰め直しで削除する
+	void eraseMarkedObjects(Array<bool>& pointMarks, const Array<bool>& placedBallMarks);
 	void startSimulation();
 	void startSimulationWithSave();
 	bool checkSimulationResult() const;
 	void endSimulation();
 	double getLowestY() const;
+
+	// ステージ全体の範囲（ポイント・StartCircle・GoalArea・PlacedBall の AABB）
+	// 追加では範囲を広げるだけ、移動・削除では無効化して次に参照したときに1回だけ再計算する
+	Optional<RectF> getBounds() const;
+	void expandBounds(const RectF& rect);
+	Optional<RectF> calculateBounds() const;
+
+	// カーソル付近にあり得るレイヤーオブジェクトの m_layerOrder 上の位置（手前から）
+	// 実際に当たっているかは呼び出し側で判定する
+	Array<int32> pickCandidates(const Vec2& pos, double margin) const;
+	void invalidatePickGrid() const { m_isPickGridDirty = true; touchEditGeneration(); }
+	void insertToPickGrid(int32 layerPos) const;  // 作り直しからも呼ぶので編集世代は進めない（追加側で進める）
+
+	// 同じ線分（向きは問わない）のエッジがあるか
+	bool containsEdgeSegment(const EdgeSegment& segment) const;
+	void insertToEdgeSegmentSet(int32 edgeIndex) const;
+
+	// 移動・削除・復元など、形や並びが変わったときに呼ぶ
+	void invalidateSpatialCaches() const { m_isBoundsDirty = true; m_isPickGridDirty = true; m_isEdgeSegmentSetDirty = true; m_isAreaSelectIndexDirty = true; touchEditGeneration(); }
+
+	// 編集世代（形・並びが変わるたびに進む。ステージごとに数えるので、別スレッドで複製を編集しても干渉しない）
+	// 描画のキャッシュはステージのアドレスと組にして持ち、値が変わったときだけ中身を照合する
+	uint64 editGeneration() const { return m_editGeneration; }
+	void touchEditGeneration() const { ++m_editGeneration; }
+
+	// 範囲選択の索引（ロックされていないオブジェクトの位置と、グループごとの外接矩形）
+	const AreaSelectIndex& areaSelectIndex() const;
+
+	// 軌跡の記録
+	void recordTrajectory();
+	bool hasTrajectoryRecording() const;
+	size_t trajectoryMemoryUsage() const;
 	
 	// インベントリ操作
 	void addInventorySlot(BallKind ballKind, Optional<int32> maxCount);
@@ -183,13 +310,17 @@ public:
 	bool isQueriesInitialState() const;
 	
 	// 編集不可エリア操作
-	void addNonEditableArea(const RectF& rect) { m_nonEditableAreas.push_back(rect); }
+	void addNonEditableArea(const RectF& rect) { m_nonEditableAreas.push_back(rect); m_isNonEditableAreaIndexDirty = true; }
 	const Array<RectF>& nonEditableAreas() const { return m_nonEditableAreas; }
 	bool isPointInNonEditableArea(const Vec2& pos) const;
 	bool isLineAllowedInEditableArea(const Line& line) const;
+	// lines のすべてが isLineAllowedInEditableArea か（ドラッグ中の多数のエッジをまとめて判定する）
+	bool areLinesAllowedInEditableArea(const Array<Line>& lines) const;
+	const NonEditableAreaIndex& nonEditableAreaIndex() const;
 
 	// Undo/Redo用スナップショット
-	StageSnapshot createSnapshot() const;
+	// base を渡すと、base と同じ内容の要素は base のものを共有する
+	StageSnapshot createSnapshot(const StageSnapshot* base = nullptr) const;
 	void restoreSnapshot(const StageSnapshot& snapshot);
 
 	PointEdgeGroup getAllSelectableObjectsAsPointEdgeGroup() const;
@@ -199,6 +330,16 @@ public:
 	int32 CalculateNumberOfObjects() const;
 	int32 CalculateTotalLength() const;
 
+	// 差分更新しているスコアの集計（毎フレーム読んでよい）
+	const ScoreCounters& scoreCounters() const;
+	// 全エッジ・全ボールを走査して集計し直す（デバッグでの照合用）
+	ScoreCounters computeScoreCounters() const;
+	void invalidateScoreCounters() const { m_isScoreCountersDirty = true; }
+	void addEdgeToScore(int32 edgeIndex) const;
+	void addPlacedBallToScore(int32 index) const;
+	// 形を変えずにエッジの長さだけが変わったとき（ドラッグ移動）。deltaUnits は ScoreCounters::LengthUnits の差
+	void addToScoreLength(int64 deltaUnits) const;
+
 	void restoreRecord(const StageRecord& record);
 
 	void save(FilePath path = {}) const;
@@ -16,8 +16,8 @@ bool StageEditUI::eraseSelection(Stage& stage)
 			stage.returnToInventory(ball.kind);
 		}
 		else if (s.type == SelectType::Group) {
-			const auto& group = stage.m_groups.at(s.id);
-			for (const auto& placedBallId : group.getAllPlacedBallIds()) {
+			const auto group = stage.groupMembers(s.id);
+			for (const auto& placedBallId : group.placedBallIds) {
 				const auto& ball = stage.m_placedBalls[placedBallId];
 				stage.returnToInventory(ball.kind);
 			}
@@ -43,9 +43,13 @@ bool StageEditUI::canGroup(const Stage& stage) const
 		}
 	}
 
-	for (const auto& edge : stage.m_edges) {
-		if (addedPointIds.contains(edge.ids[0]) and addedPointIds.contains(edge.ids[1])) {
-			selectedCount++;
+	// 両端とも選ばれているエッジを、選ばれた点から辿って数える（各エッジは ids[0] の側で1回だけ）
+	for (auto pid : addedPointIds) {
+		for (auto edgeIndex : stage.incidentEdges(pid)) {
+			const auto& edge = stage.m_edges[edgeIndex];
+			if (edge.ids[0] == pid and addedPointIds.contains(edge.ids[1])) {
+				selectedCount++;
+			}
 		}
 	}
 
@@ -74,6 +78,7 @@ bool StageEditUI::groupSelection(Stage& stage)
 {
 	if (!canGroup(stage)) return false;
 	stage.createGroupFromSelection(m_selectedIDs.m_ids);
+	m_selectedIDs.touch();
 	return true;
 }
 
@@ -81,13 +86,8 @@ bool StageEditUI::ungroupSelection(Stage& stage)
 {
 	if (!canUngroup(stage)) return false;
 	int32 onlySelectedGroupId = m_selectedIDs.begin()->id;
-	auto& group = stage.m_groups.at(onlySelectedGroupId);
-	if (group.isLocked) return false;
-	for (auto& subGroup : group.m_groups) {
-		int32 newGroupId = stage.m_nextGroupId++;
-		stage.m_groups[newGroupId] = subGroup;
-	}
-	stage.m_groups.erase(onlySelectedGroupId);
+	if (stage.m_groups.at(onlySelectedGroupId).isLocked) return false;
+	stage.ungroup(onlySelectedGroupId);
 	m_selectedIDs.clear();
 	return true;
 }
@@ -111,6 +111,7 @@ void StageEditUI::resetTransientState()
 	m_lineCreateStart.reset();
 	m_selectAreaStart.reset();
 	m_dragOffset.reset();
+	m_dragSession.end();
 	m_didDragMove = false;
 	m_selectSingleLine = false;
 	m_lastSelectAreaBottomRight.reset();
@@ -126,16 +127,30 @@ int32 StageEditUI::getDrawOneGridLength() const
 	return static_cast<int32>(Clamp(Math::Exp2(Round(Math::Log2(4.0 / Graphics2D::GetMaxScaling()))), 1.0, 16.0)) * 5;
 }
 
+bool StageEditUI::isHoverAlive(const Stage& stage, const HoverInfo& hoverInfo) const
+{
+	switch (hoverInfo.type) {
+	case HoverType::Point: return stage.m_points.isAlive(SlotHandle{ hoverInfo.id, hoverInfo.generation });
+	case HoverType::Edge: return stage.m_edges.isAlive(SlotHandle{ hoverInfo.id, hoverInfo.generation });
+	case HoverType::PlacedBall: return stage.m_placedBalls.isAlive(SlotHandle{ hoverInfo.id, hoverInfo.generation });
+	case HoverType::StartCircle: return InRange(hoverInfo.id, 0, static_cast<int32>(stage.m_startCircles.size()) - 1);
+	case HoverType::GoalArea: return InRange(hoverInfo.id, 0, static_cast<int32>(stage.m_goalAreas.size()) - 1);
+	case HoverType::Group: return stage.m_groups.contains(hoverInfo.id);
+	}
+	return false;
+}
+
 bool StageEditUI::isHoveredPoint(const Stage& stage, const Optional<HoverInfo>& hoverInfo, int32 pointId) const
 {
-	if (not hoverInfo) return false;
+	if (not hoverInfo || not isHoverAlive(stage, *hoverInfo)) return false;
 	if (hoverInfo->type == HoverType::Point && hoverInfo->id == pointId) return true;
-	if (hoverInfo->type == HoverType::Group) return stage.m_groups.at(hoverInfo->id).containsPointRecursive(pointId);
+	// ホバー中のグループは常にトップレベルなので、逆引きの結果と比べればよい
+	if (hoverInfo->type == HoverType::Group) return stage.findTopGroup(pointId) == hoverInfo->id;
 	if (hoverInfo->type == HoverType::Edge) {
-		auto& edge = stage.m_edges.at(hoverInfo->id);
+		const auto& edge = stage.m_edges[hoverInfo->id];
 		for (auto pid : edge.ids) {
 			if (auto topGroupId = stage.findTopGroup(pid)) {
-				if (stage.m_groups.at(*topGroupId).containsPointRecursive(pointId)) return true;
+				if (stage.findTopGroup(pointId) == topGroupId) return true;
 			}
 			else if (pid == pointId) {
 				return true;
@@ -149,7 +164,7 @@ bool StageEditUI::isHoveredStartCircle(const Stage& stage, int32 index) const
 {
 	if (m_hoveredInfo && m_hoveredInfo->type == HoverType::StartCircle && m_hoveredInfo->id == index) return true;
 	if (m_hoveredInfo && m_hoveredInfo->type == HoverType::Group) {
-		return stage.m_groups.at(m_hoveredInfo->id).containsStartCircleRecursive(index);
+		return stage.findTopGroupForStartCircle(index) == m_hoveredInfo->id;
 	}
 	return false;
 }
@@ -158,7 +173,7 @@ bool StageEditUI::isHoveredGoalArea(const Stage& stage, int32 index) const
 {
 	if (m_hoveredInfo && m_hoveredInfo->type == HoverType::GoalArea && m_hoveredInfo->id == index) return true;
 	if (m_hoveredInfo && m_hoveredInfo->type == HoverType::Group) {
-		return stage.m_groups.at(m_hoveredInfo->id).containsGoalAreaRecursive(index);
+		return stage.findTopGroupForGoalArea(index) == m_hoveredInfo->id;
 	}
 	return false;
 }
@@ -167,7 +182,7 @@ bool StageEditUI::isHoveredPlacedBall(const Stage& stage, int32 index) const
 {
 	if (m_hoveredInfo && m_hoveredInfo->type == HoverType::PlacedBall && m_hoveredInfo->id == index) return true;
 	if (m_hoveredInfo && m_hoveredInfo->type == HoverType::Group) {
-		return stage.m_groups.at(m_hoveredInfo->id).containsPlacedBallRecursive(index);
+		return stage.findTopGroupForPlacedBall(index) == m_hoveredInfo->id;
 	}
 	return false;
 }
@@ -177,8 +192,8 @@ bool StageEditUI::isHoveredEdge(const Stage& stage, int32 index) const
 	if (m_hoveredInfo && m_hoveredInfo->type == HoverType::Edge && m_hoveredInfo->id == index) return true;
 	if (m_hoveredInfo && m_hoveredInfo->type == HoverType::Group) {
 		const auto& edge = stage.m_edges[index];
-		return stage.m_groups.at(m_hoveredInfo->id).containsPointRecursive(edge[0])
-			|| stage.m_groups.at(m_hoveredInfo->id).containsPointRecursive(edge[1]);
+		return stage.findTopGroup(edge[0]) == m_hoveredInfo->id
+			|| stage.findTopGroup(edge[1]) == m_hoveredInfo->id;
 	}
 	return false;
 }
@@ -188,8 +203,10 @@ void StageEditUI::updateHoverInfo(Stage& stage, SingleUseCursorPos& cursorPos)
 	m_hoveredInfo.reset();
 	if (not cursorPos) return;
 
-	for (auto it = stage.m_layerOrder.rbegin(); it != stage.m_layerOrder.rend(); ++it) {
-		const auto& obj = *it;
+	// グリッドから近くのオブジェクトだけを手前から調べる（判定の優先順は全走査と同じ）
+	const double margin = Max(HOVER_THRESHOLD, POINT_HOVER_THRESHOLD);
+	for (int32 layerPos : stage.pickCandidates(cursorPos.value(), margin)) {
+		const auto& obj = stage.m_layerOrder[layerPos];
 
 		switch (obj.type) {
 		case LayerObjectType::PlacedBall: {
@@ -200,7 +217,7 @@ void StageEditUI::updateHoverInfo(Stage& stage, SingleUseCursorPos& cursorPos)
 					m_hoveredInfo = HoverInfo{ HoverType::Group, *topGroupId };
 				}
 				else {
-					m_hoveredInfo = HoverInfo{ HoverType::PlacedBall, obj.id };
+					m_hoveredInfo = HoverInfo{ HoverType::PlacedBall, obj.id, stage.m_placedBalls.handleOf(obj.id).generation };
 				}
 				return;
 			}
@@ -247,7 +264,7 @@ void StageEditUI::updateHoverInfo(Stage& stage, SingleUseCursorPos& cursorPos)
 				const Vec2& point_pos = stage.m_points.at(point_id);
 				if ((point_pos - cursorPos.value()).length() <= POINT_HOVER_THRESHOLD) {
 					cursorPos.reset();
-					m_hoveredInfo = HoverInfo{ HoverType::Point, point_id };
+					m_hoveredInfo = HoverInfo{ HoverType::Point, point_id, stage.m_points.handleOf(point_id).generation };
 					return;
 				}
 			}
@@ -269,7 +286,7 @@ void StageEditUI::updateHoverInfo(Stage& stage, SingleUseCursorPos& cursorPos)
 					m_hoveredInfo = HoverInfo{ HoverType::Group, *groupId };
 				}
 				else {
-					m_hoveredInfo = HoverInfo{ HoverType::Edge, obj.id };
+					m_hoveredInfo = HoverInfo{ HoverType::Edge, obj.id, stage.m_edges.handleOf(obj.id).generation };
 				}
 				return;
 			}
@@ -284,7 +301,10 @@ void StageEditUI::updateDragObject(Stage& stage, SingleUseCursorPos& cursorPos,
 	if (MouseL.down()) {
 		// クリック開始位置を記録（メニュー表示用）
 		m_clickStartPos = Cursor::PosF();
-		
+
+		if (m_hoveredInfo && not isHoverAlive(stage, *m_hoveredInfo)) {
+			m_hoveredInfo.reset();
+		}
 		if (m_hoveredInfo) {
 			bool selectSingleLine = false;
 
@@ -469,10 +489,13 @@ void StageEditUI::updateDragObject(Stage& stage, SingleUseCursorPos& cursorPos,
 		if (auto beginPos = m_selectedIDs.getBeginPointOfSelectedObjects(stage)) {
 			Vec2 deltaMove = targetPos - *beginPos;
 			if (deltaMove != Vec2{ 0, 0 }) {
-				bool canMove = m_selectedIDs.isMovedSelectedNotInNonEditableArea(stage, deltaMove);
+				if (not m_dragSession.isActiveFor(m_selectedIDs, stage)) {
+					m_dragSession.begin(m_selectedIDs, stage);
+				}
+				bool canMove = m_dragSession.canMove(stage, deltaMove);
 
 				if (canMove) {
-					m_selectedIDs.moveSelectedObjects(stage, deltaMove);
+					m_dragSession.move(stage, deltaMove);
 					m_didDragMove = true;
 				}
 				else {
@@ -483,7 +506,7 @@ void StageEditUI::updateDragObject(Stage& stage, SingleUseCursorPos& cursorPos,
 						for (Point dir : { Point{ 0,-1 }, Point{ 1,-1 }, Point{ 1,0 }, Point{ 1,1 }, Point{ 0,1 }, Point{ -1,1 }, Point{ -1,0 }, Point{ -1,-1 } }) {
 							Vec2 newDelta = bestDelta + dir * getOneGridLength();
 							if ((targetPos - *beginPos - newDelta).length() < nowLen
-								&& m_selectedIDs.isMovedSelectedNotInNonEditableArea(stage, newDelta)) {
+								&& m_dragSession.canMove(stage, newDelta)) {
 								bestDelta = newDelta;
 								allDirEnded = false;
 							}
@@ -492,7 +515,7 @@ void StageEditUI::updateDragObject(Stage& stage, SingleUseCursorPos& cursorPos,
 					}
 
 					if (bestDelta != Vec2{ 0, 0 }) {
-						m_selectedIDs.moveSelectedObjects(stage, bestDelta);
+						m_dragSession.move(stage, bestDelta);
 						m_didDragMove = true;
 					}
 				}
@@ -503,6 +526,7 @@ void StageEditUI::updateDragObject(Stage& stage, SingleUseCursorPos& cursorPos,
 
 	if (MouseL.up() && m_dragOffset) {
 		m_dragOffset.reset();
+		m_dragSession.end();
 		cursorPos.release();
 		if (m_didDragMove) {
 			onStageEdited(stage);
@@ -556,8 +580,8 @@ void StageEditUI::updateLineCreateMode(Stage& stage, bool isDoubleClicked, Singl
 			Line line(m_lineCreateStart.value(), Snap(m_lineCreateLastPos, getOneGridLength()));
 			if (line.length() >= 5.0) {
 				if (stage.isLineAllowedInEditableArea(line)) {
-					stage.addLine(line);
-					auto& edge = stage.m_edges.back();
+					const int32 edgeId = stage.addLine(line);
+					const auto& edge = stage.m_edges[edgeId];
 					m_selectedIDs.clear();
 					m_selectedIDs.insert(SelectedID{ SelectType::Point, edge[0] });
 					m_selectedIDs.insert(SelectedID{ SelectType::Point, edge[1] });
@@ -629,71 +653,92 @@ void StageEditUI::update(Stage& stage, bool isDoubleClicked, SingleUseCursorPos&
 	updateSelectArea(stage, cursorPos, openContextMenu, useRightDragSelect, cancelSelectArea);
 }
 
-void StageEditUI::drawWorld(const Stage& stage, const MyCamera2D& camera) const
+void StageEditUI::drawPlayback(const Stage& stage, const Array<TrajectoryRecording::BallFrame>& frames) const
 {
-	// simulation mode draw: draw same world objects, except edit-only visuals
-	if (stage.m_isSimulationRunning) {
-		// non-editable areas
-		if (!stage.nonEditableAreas().empty()) {
-			for (const auto& r : stage.nonEditableAreas()) {
-				r.rounded(6).draw(ColorF(0.15, 0.08, 0.08, 0.25));
-				r.rounded(6).drawFrame(2.0 / Graphics2D::GetMaxScaling(), ColorF(0.9, 0.35, 0.35, 0.7));
-			}
+	drawSimulationScene(stage);
+
+	for (const auto& frame : frames) {
+		DrawBall(frame.pos, frame.angle, frame.kind);
+	}
+}
+
+void StageEditUI::drawSimulationScene(const Stage& stage) const
+{
+	// non-editable areas
+	if (!stage.nonEditableAreas().empty()) {
+		for (const auto& r : stage.nonEditableAreas()) {
+			r.rounded(6).draw(ColorF(0.15, 0.08, 0.08, 0.25));
+			r.rounded(6).drawFrame(2.0 / Graphics2D::GetMaxScaling(), ColorF(0.9, 0.35, 0.35, 0.7));
 		}
+	}
 
-		// layer ordered draw (no selection/hover effects)
-		for (auto it = stage.m_layerOrder.begin(); it != stage.m_layerOrder.end(); ++it) {
-			const auto& obj = *it;
-			switch (obj.type) {
-			case LayerObjectType::GoalArea: {
-				int32 i = obj.id;
-				const auto& r = stage.m_goalAreas[i];
-				ColorF color = ColorF(0.2, 0.65, 0.3, 0.5);
-				ColorF frameColor = ColorF(0.3, 0.75, 0.4, 0.7);
-				r.rect.draw(color);
-				r.rect.drawFrame(2.0 / Graphics2D::GetMaxScaling(), frameColor);
-				FontAsset(U"Regular")(U"{}"_fmt(static_cast<char32>(U'A' + i))).drawAt(14.0 / Graphics2D::GetMaxScaling(), r.rect.center(), ColorF(1.0));
-				break;
-			}
-			case LayerObjectType::StartCircle: {
-				int32 i = obj.id;
-				const auto& c = stage.m_startCircles[i];
-				ColorF color = ColorF(0.2, 0.65, 0.3, 0.5);
-				ColorF frameColor = ColorF(0.3, 0.75, 0.4, 0.7);
-				c.circle.draw(color);
-				c.circle.drawFrame(2.0 / Graphics2D::GetMaxScaling(), frameColor);
-				FontAsset(U"Regular")(U"{}"_fmt(static_cast<char32>(U'a' + i))).drawAt(14.0 / Graphics2D::GetMaxScaling(), c.circle.center, ColorF(1.0));
-				break;
-			}
-			case LayerObjectType::PlacedBall: {
-				// while simulating, placed balls should be shown as physical bodies (startBallsInWorld)
-				break;
-			}
-			case LayerObjectType::Edge: {
-				int32 i = obj.id;
-				const auto& edge = stage.m_edges[i];
-				const Vec2& p1 = stage.m_points.at(edge[0]);
-				const Vec2& p2 = stage.m_points.at(edge[1]);
-				ColorF lineColor = ColorF(0.6, 0.65, 0.7);
-				if (edge.isLocked) { lineColor *= 0.6; }
-				Line(p1 + Vec2{ 2, 2 }, p2 + Vec2{ 2, 2 }).draw(3.0 / Graphics2D::GetMaxScaling(), ColorF(0.0, 0.2));
-				Line(p1, p2).draw(2.5 / Graphics2D::GetMaxScaling(), lineColor);
-				break;
-			}
-			}
+	// 先頭のロックされたオブジェクトはキャッシュから描く
+	const size_t staticCount = m_staticLayers.draw(stage, Graphics2D::GetMaxScaling());
+
+	// layer ordered draw (no selection/hover effects)
+	for (auto it = stage.m_layerOrder.begin() + staticCount; it != stage.m_layerOrder.end(); ++it) {
+		const auto& obj = *it;
+		switch (obj.type) {
+		case LayerObjectType::GoalArea: {
+			int32 i = obj.id;
+			const auto& r = stage.m_goalAreas[i];
+			ColorF color = ColorF(0.2, 0.65, 0.3, 0.5);
+			ColorF frameColor = ColorF(0.3, 0.75, 0.4, 0.7);
+			r.rect.draw(color);
+			r.rect.drawFrame(2.0 / Graphics2D::GetMaxScaling(), frameColor);
+			FontAsset(U"Regular")(U"{}"_fmt(static_cast<char32>(U'A' + i))).drawAt(14.0 / Graphics2D::GetMaxScaling(), r.rect.center(), ColorF(1.0));
+			break;
 		}
+		case LayerObjectType::StartCircle: {
+			int32 i = obj.id;
+			const auto& c = stage.m_startCircles[i];
+			ColorF color = ColorF(0.2, 0.65, 0.3, 0.5);
+			ColorF frameColor = ColorF(0.3, 0.75, 0.4, 0.7);
+			c.circle.draw(color);
+			c.circle.drawFrame(2.0 / Graphics2D::GetMaxScaling(), frameColor);
+			FontAsset(U"Regular")(U"{}"_fmt(static_cast<char32>(U'a' + i))).drawAt(14.0 / Graphics2D::GetMaxScaling(), c.circle.center, ColorF(1.0));
+			break;
+		}
+		case LayerObjectType::PlacedBall: {
+			// while simulating, placed balls should be shown as physical bodies (startBallsInWorld)
+			break;
+		}
+		case LayerObjectType::Edge: {
+			int32 i = obj.id;
+			const auto& edge = stage.m_edges[i];
+			const Vec2& p1 = stage.m_points.at(edge[0]);
+			const Vec2& p2 = stage.m_points.at(edge[1]);
+			ColorF lineColor = ColorF(0.6, 0.65, 0.7);
+			if (edge.isLocked) { lineColor *= 0.6; }
+			Line(p1 + Vec2{ 2, 2 }, p2 + Vec2{ 2, 2 }).draw(3.0 / Graphics2D::GetMaxScaling(), ColorF(0.0, 0.2));
+			Line(p1, p2).draw(2.5 / Graphics2D::GetMaxScaling(), lineColor);
+			break;
+		}
+		}
+	}
+}
+
+void StageEditUI::DrawBall(const Vec2& pos, double angle, BallKind kind)
+{
+	const Circle circle(pos, GetBallRadius(kind));
+	circle.draw(GetBallColor(kind));
+
+	HSV color = HSV(GetBallColor(kind));
+	color.s *= 0.8;
+	circle.drawPie(angle, Math::HalfPi, color);
+	circle.drawPie(angle + Math::Pi, Math::HalfPi, color);
+}
+
+void StageEditUI::drawWorld(const Stage& stage, const MyCamera2D& camera) const
+{
+	// simulation mode draw: draw same world objects, except edit-only visuals
+	if (stage.m_isSimulationRunning) {
+		drawSimulationScene(stage);
 
 		// simulation balls
 		for (const auto& ball : stage.m_startBallsInWorld) {
-			ColorF ballColor = GetBallColor(ball.kind);
-			ball.body.draw(ballColor);
-
-			Circle circle(ball.body.getPos(), GetBallRadius(ball.kind));
-			double angle = ball.body.getAngle();
-			HSV color = HSV(GetBallColor(ball.kind));
-			color.s *= 0.8;
-			circle.drawPie(angle, Math::HalfPi, color);
-			circle.drawPie(angle + Math::Pi, Math::HalfPi, color);
+			if (ball.body.isEmpty()) continue;
+			DrawBall(ball.body.getPos(), ball.body.getAngle(), ball.kind);
 		}
 		return;
 	}
@@ -706,23 +751,17 @@ void StageEditUI::drawWorld(const Stage& stage, const MyCamera2D& camera) const
 		}
 	}
 
-	// grid points
-	{
-		int32 oneGridLength = getDrawOneGridLength();
-		Point tl = Floor(camera.getRegion().tl() / oneGridLength).asPoint();
-		Point br = Ceil(camera.getRegion().br() / oneGridLength).asPoint();
-		for (const auto& p : step(tl, br - tl + Point::One())) {
-			if (IsEven(p.x) and IsEven(p.y)) {
-				RectF(Arg::center = p * oneGridLength, 2 / Graphics2D::GetMaxScaling()).draw(ColorF(1, 0.25));
-			}
-			else {
-				RectF(Arg::center = p * oneGridLength, 2 / Graphics2D::GetMaxScaling()).draw(ColorF(1, 0.15));
-			}
-		}
-	}
+	// grid points（タイル画像を敷き詰めて1回で描く）
+	m_gridDots.draw(camera.getRegion(), getDrawOneGridLength(), Graphics2D::GetMaxScaling());
+
+	// 選択状態は展開済みのマスクから引く（選択が変わったフレームだけ作り直される）
+	const SelectionMask& selectionMask = m_selectedIDs.mask(stage);
+
+	// 先頭のロックされたオブジェクトはキャッシュから描く（選択・ホバーされないので色は変わらない）
+	const size_t staticCount = m_staticLayers.draw(stage, Graphics2D::GetMaxScaling());
 
 	// layer ordered draw (edit mode assumes !simulation)
-	for (auto it = stage.m_layerOrder.begin(); it != stage.m_layerOrder.end(); ++it) {
+	for (auto it = stage.m_layerOrder.begin() + staticCount; it != stage.m_layerOrder.end(); ++it) {
 		const auto& obj = *it;
 		switch (obj.type) {
 		case LayerObjectType::GoalArea: {
@@ -831,8 +870,7 @@ void StageEditUI::drawWorld(const Stage& stage, const MyCamera2D& camera) const
 				ColorF pointColor = ColorF(0.6, 0.65, 0.7);
 				if (m_selectedIDs.isSelectedPoint(stage, pointId)) {
 					pointColor = ColorF(0.4, 0.7, 1.0);
-					if (std::none_of(m_selectedIDs.begin(), m_selectedIDs.end(), [&](const SelectedID& s) { return s.type == SelectType::Group; })
-						&& std::count_if(m_selectedIDs.begin(), m_selectedIDs.end(), [&](const SelectedID& s) { return s.type == SelectType::Point; }) == 1) {
+					if (not selectionMask.hasGroup && selectionMask.pointCount == 1) {
 						Vec2 otherPointPos = stage.m_points.at(otherPointId);
 						Vec2 direction = (pointPos - otherPointPos);
 						if ((direction - Floor(direction)).isZero()) {
@@ -2,7 +2,11 @@
 
 # include <Siv3D.hpp>
 # include "Domain.hpp"
+# include "DragSession.hpp"
+# include "GridDotLayer.hpp"
 # include "InputUtils.hpp"
+# include "StaticLayerCache.hpp"
+# include "TrajectoryRecording.hpp"
 
 class Stage;
 class MyCamera2D;
@@ -36,6 +40,9 @@ public:
 	// Draw editable world objects (expects caller to have activated camera transformer)
 	void drawWorld(const Stage& stage, const MyCamera2D& camera) const;
 
+	// Draw recorded balls over the static simulation scene (no physics world needed)
+	void drawPlayback(const Stage& stage, const Array<TrajectoryRecording::BallFrame>& frames) const;
+
 	const SelectedIDSet& selectedIDs() const { return m_selectedIDs; }
 	SelectedIDSet& selectedIDs() { return m_selectedIDs; }
 	bool isLineCreateMode() const { return m_lineCreateStart.has_value(); }
@@ -61,6 +68,7 @@ private:
 	Vec2 m_lineCreateLastPos{};
 	Optional<Vec2> m_selectAreaStart;
 	Optional<Vec2> m_dragOffset;
+	DragSession m_dragSession;  // m_dragOffset がある間の選択の展開結果
 	bool m_didDragMove = false;
 	bool m_selectSingleLine = false;
 	Vec2 m_clickStartPos{};  // クリック開始位置（ワールド座標）
@@ -68,6 +76,9 @@ private:
 	// 選択エリアの右下座標（選択完了時に保存、ワールド座標）
 	Optional<Vec2> m_lastSelectAreaBottomRight;
 
+	GridDotLayer m_gridDots;  // 背景のグリッド点
+	StaticLayerCache m_staticLayers;  // 描画順の先頭のロックされたオブジェクト
+
 	static constexpr double HOVER_THRESHOLD = 7.5;
 	static constexpr double POINT_HOVER_THRESHOLD = 10.0;
 
@@ -75,6 +86,8 @@ private:
 	int32 getOneGridLength() const;
 	int32 getDrawOneGridLength() const;
 
+	// ホバー先がまだステージにあるか（取った後の編集で消えたり、スロットが使い回されたりしていないか）
+	bool isHoverAlive(const Stage& stage, const HoverInfo& hoverInfo) const;
 	bool isHoveredPoint(const Stage& stage, const Optional<HoverInfo>& hoverInfo, int32 pointId) const;
 	bool isHoveredStartCircle(const Stage& stage, int32 index) const;
 	bool isHoveredGoalArea(const Stage& stage, int32 index) const;
@@ -85,5 +98,9 @@ private:
 	void updateHoverInfo(Stage& stage, SingleUseCursorPos& cursorPos);
 	void updateDragObject(Stage& stage, SingleUseCursorPos& cursorPos, const std::function<void(Stage&)>& onStageEdited, Optional<DraggingBallInfo>& draggingBall, const OpenContextMenuCallback& openContextMenu);
 	void updateSelectArea(Stage& stage, SingleUseCursorPos& cursorPos, const OpenContextMenuCallback& openContextMenu, bool useRightDragSelect, bool cancelSelectArea);
+
+	// simulation / playback draw helpers
+	void drawSimulationScene(const Stage& stage) const;
+	static void DrawBall(const Vec2& pos, double angle, BallKind kind);
 };
 
@@ -42,6 +42,7 @@ StageUI::StageUI() {
 		m_simulationStopButtonRect = RectF{ x, btnY, 90, btnH };
 		x += m_simulationStopButtonRect.w + gap;
 		m_simulationFastForwardButtonRect = RectF{ x, btnY, 60, btnH };
+		m_replayButtonRect = RectF{ padding, 90, 110, 40 };
 
 		const double iconBtnSize = 36;
 		const double iconBtnGap = 10;
@@ -65,6 +66,10 @@ StageUI::StageUI() {
 		const double nextH = 50;
 		const double nextY = m_queryPanelRect.y + m_queryPanelRect.h + 10;
 		m_nextStageButtonRect = RectF{ m_queryPanelRect.x, nextY, nextW, nextH };
+
+		// replay seek bar: replaces the replay button while playing, up to the query panel
+		const double playerX = m_replayButtonRect.x;
+		m_trajectoryPlayer.setRect(RectF{ playerX, m_replayButtonRect.y, Max(0.0, m_queryPanelRect.x - playerX - 20), m_replayButtonRect.h });
 	}
 
 	// インベントリUIの初期位置設定（画面下部）
@@ -99,10 +104,10 @@ void StageUI::onStageEnter(Stage& stage, bool isSameWithLastStage)
 
 	if (not isSameWithLastStage) {
 		clearUndoRedoHistory();
-		m_undoStack.push_back(stage.createSnapshot());
+		appendUndoSnapshot(stage.createSnapshot());
 	}
 	else if (m_undoStack.empty()) {
-		m_undoStack.push_back(stage.createSnapshot());
+		appendUndoSnapshot(stage.createSnapshot());
 	}
 	
 	// クエリ進捗を初期化（まだ初期化されていない場合）
@@ -126,7 +131,8 @@ void StageUI::onStageEnter(Stage& stage, bool isSameWithLastStage)
 	m_shareStatus = ShareStatus::Idle;
 
 	// シミュレーション速度を現在の設定に同期
-	stage.m_simulationSpeed = kSimulationSpeeds[m_speedIndex];
+	m_trajectoryPlayer.stop();
+	stage.m_simulationSpeed = currentSimulationSpeed();
 }
 
 void StageUI::onStageExit(Stage& stage)
@@ -141,6 +147,8 @@ void StageUI::onStageExit(Stage& stage)
 	m_cursorPos.release();
 	m_singleQueryMode = false;
 	m_wasLineCreateMode = false;
+	m_verifyAllInvalidated = true;
+	m_trajectoryPlayer.stop();
 	
 	// 十字キーUIを非表示
 	m_dpadUI.setVisible(false);
@@ -160,6 +168,8 @@ void StageUI::onStageEdited(Stage& stage)
 	pushUndoState(stage);
 
 	stage.resetQueryProgress();
+	m_verifyAllInvalidated = true;
+	m_trajectoryPlayer.stop();
 
 	// Share 状態をリセット
 	m_shareStatus = ShareStatus::Idle;
@@ -167,19 +177,26 @@ void StageUI::onStageEdited(Stage& stage)
 
 void StageUI::pasteFromClipboard(Stage& stage)
 {
-	auto oldClipboard = m_clipboard; // コピー前の状態を保存
+	// ステージに同じ線分がすべてある間は、ずらす量だけを増やしていく（クリップボードは最後に1回だけ動かす）
+	Vec2 offset{ 0, 0 };
 	for (int32 i = 0; i < 100; i++) {
-		if (hasSameObjectWithClipboard(stage)) {
-			m_clipboard.moveBy({ 20,20 });
+		if (hasSameObjectWithClipboard(stage, offset)) {
+			offset += Vec2{ 20, 20 };
 		}
 		else {
 			break;
 		}
 	}
 
-	stage.pastePointEdgeGroup(m_clipboard, m_editUI.selectedIDs());
+	if (offset.isZero()) {
+		stage.pastePointEdgeGroup(m_clipboard, m_editUI.selectedIDs());
+	}
+	else {
+		PointEdgeGroup moved = m_clipboard;
+		moved.moveBy(offset);
+		stage.pastePointEdgeGroup(moved, m_editUI.selectedIDs());
+	}
 
-	m_clipboard = oldClipboard;
 	onStageEdited(stage);
 }
 
@@ -190,43 +207,20 @@ void StageUI::eraseSelection(Stage& stage)
 	}
 }
 
-bool StageUI::hasSameObjectWithClipboard(const Stage& stage) const
+bool StageUI::hasSameObjectWithClipboard(const Stage& stage, const Vec2& offset) const
 {
 	if (m_clipboard.m_edges.empty()) return false;
 
-	Array<Line> clipboardLines;
+	// ステージ内に同じ線分（向きは問わない）がすべて存在するかチェック
 	for (const auto& edge : m_clipboard.m_edges) {
-		const Vec2& p1 = m_clipboard.m_points.at(edge[0]);
-		const Vec2& p2 = m_clipboard.m_points.at(edge[1]);
-		clipboardLines.push_back(Line(p1, p2));
-	}
-
-
-
-	// Array<PlacedBall> clipboardBalls = m_clipboard.m_placedBalls;
-
-	// ステージ内に同じオブジェクトがすべて存在するかチェック
-	for (const auto& edge : stage.m_edges) {
-		const Vec2& p1 = stage.m_points.at(edge[0]);
-		const Vec2& p2 = stage.m_points.at(edge[1]);
-		Line lineInStage(p1, p2);
-		// clipboardLines に同じ線分があれば削除
-		clipboardLines.remove_if([&](const Line& l) {
-			return (l.begin == lineInStage.begin && l.end == lineInStage.end) ||
-				   (l.begin == lineInStage.end && l.end == lineInStage.begin);
-		});
+		const Vec2 p1 = m_clipboard.m_points.at(edge[0]) + offset;
+		const Vec2 p2 = m_clipboard.m_points.at(edge[1]) + offset;
+		if (not stage.containsEdgeSegment(EdgeSegment{ p1, p2 })) {
+			return false;
+		}
 	}
 
-	//for (const auto& placedBallInStage : stage.m_placedBalls) {
-	//	// clipboardBalls に同じボールがあれば削除
-	//	clipboardBalls.remove_if([&](const PlacedBall& b) {
-	//		return b.kind == placedBallInStage.kind &&
-	//			   b.circle.center == placedBallInStage.circle.center &&
-	//			   b.circle.r == placedBallInStage.circle.r;
-	//	});
-	//}
-
-	return clipboardLines.empty(); // && clipboardBalls.empty();
+	return true;
 }
 
 void StageUI::update(Game& game, Stage& stage, double dt)
@@ -564,6 +558,7 @@ void StageUI::update(Game& game, Stage& stage, double dt)
 			};
 
 			// インベントリから出したボールは、禁止領域に被ったらインベントリに戻す
+			int32 placedBallId;
 			if (!m_draggingBall->placedBallId.has_value()) {
 				if (!isPosAllowed(requestedPos)) {
 					stage.returnToInventory(ballKind);
@@ -572,7 +567,7 @@ void StageUI::update(Game& game, Stage& stage, double dt)
 					return;
 				}
 				// allowed のときのみ配置
-				stage.addPlacedBall(PlacedBall{ requestedPos, ballKind });
+				placedBallId = stage.addPlacedBall(PlacedBall{ requestedPos, ballKind });
 			}
 			else {
 				// 既にステージ上にあったボールは、他の選択オブジェクト同様に「有効な座標」を探し続ける
@@ -605,13 +600,13 @@ void StageUI::update(Game& game, Stage& stage, double dt)
 					}
 				}
 
-				stage.addPlacedBall(PlacedBall{ bestPos, ballKind });
+				placedBallId = stage.addPlacedBall(PlacedBall{ bestPos, ballKind });
 			}
 
 			// 配置したボールを選択状態にする
 			auto& sel = m_editUI.selectedIDs();
 			sel.clear();
-			sel.insert(SelectedID{ SelectType::PlacedBall, static_cast<int32>(stage.m_placedBalls.size()) - 1});
+			sel.insert(SelectedID{ SelectType::PlacedBall, placedBallId });
 
 			onStageEdited(stage);  // 編集検出
 
@@ -640,7 +635,8 @@ void StageUI::update(Game& game, Stage& stage, double dt)
 	}
 
 	// クエリパネル更新（クリックされたら単独実行モード）
-	if (m_queryPanel.update(stage, m_cursorPos, dt)) {
+	// 並列検証中は結果が混ざらないよう単独実行させない
+	if (not isVerifyingAll() and m_queryPanel.update(stage, m_cursorPos, dt)) {
 		m_editUI.selectedIDs().clear();
 		m_singleQueryMode = true;
 	}
@@ -793,11 +789,26 @@ void StageUI::update(Game& game, Stage& stage, double dt)
 	// Simulation Start ボタン
 	if (m_cursorPos.intersects_use(m_simulationStartButtonRect)) {
 		if (MouseL.down()) {
-			if (not stage.m_isSimulationRunning) {
+			if (not stage.m_isSimulationRunning and not isVerifyingAll()) {
 				m_editUI.selectedIDs().clear();
 				stage.m_currentQueryIndex = 0;
 				m_singleQueryMode = false;
-				stage.startSimulationWithSave();
+
+				// Shift + Run: 全クエリを並列に検証し、結果だけを反映する（スレッドが使えるデスクトップ版のみ）
+				bool verifyAll = false;
+# if not SIV3D_PLATFORM(WEB)
+				verifyAll = KeyShift.pressed();
+# endif
+				m_trajectoryPlayer.stop();
+				stage.m_simulationSpeed = currentSimulationSpeed();
+				if (verifyAll) {
+					stage.save();
+					m_verifyAllTask = SimulationEngine::VerifyAllQueriesAsync(stage);
+					m_verifyAllInvalidated = false;
+				}
+				else {
+					stage.startSimulationWithSave();
+				}
 				// 
 				// << U"Simulation Start!":
 			}
@@ -823,6 +834,7 @@ void StageUI::update(Game& game, Stage& stage, double dt)
 				stage.endSimulation();
 				// Console << U"Simulation Stopped";
 			}
+			m_trajectoryPlayer.stop();
 		}
 		Cursor::RequestStyle(CursorStyle::Hand);
 	}
@@ -830,97 +842,64 @@ void StageUI::update(Game& game, Stage& stage, double dt)
 	// Simulation Fast Forward ボタン
 	if (m_cursorPos.intersects_use(m_simulationFastForwardButtonRect)) {
 		if (MouseL.down()) {
-			m_speedIndex = (m_speedIndex + 1) % static_cast<int32>(kSimulationSpeeds.size());
-			stage.m_simulationSpeed = kSimulationSpeeds[m_speedIndex];
+			m_speedIndex = (m_speedIndex + 1) % static_cast<int32>(kSimulationSpeeds.size() + 1);
+			stage.m_simulationSpeed = currentSimulationSpeed();
 		}
 		Cursor::RequestStyle(CursorStyle::Hand);
 	}
 
-	if (stage.m_isSimulationRunning) {
-		if (not stage.m_isSimulationPaused) {
-			double fallThreshold = stage.getLowestY() + 100;
-			for (auto& c : stage.m_startBallsInWorld) { 
-				if (c.body.getPos().y > fallThreshold) {
-					c.body.release();
-					
-				} 
-			}
-			stage.m_startBallsInWorld.remove_if([](const auto& c) { return c.body.isEmpty(); });
-
-			// 終了判定: 全てのボールが (静止 OR ゴール侵入後1秒経過) AND クエリが全てのボールを放出済み
-			bool allFinished = true;
-			for (const auto& c : stage.m_startBallsInWorld) { 
-				if (c.body.isEmpty()) {
-					continue;
-				}
+	// 記録した軌跡を再生（物理演算なし）
+	if (not stage.m_isSimulationRunning and not m_trajectoryPlayer.isActive() and stage.hasTrajectoryRecording()
+		and m_cursorPos.intersects_use(m_replayButtonRect)) {
+		if (MouseL.down()) {
+			m_editUI.selectedIDs().clear();
+			m_trajectoryPlayer.start(stage);
+		}
+		Cursor::RequestStyle(CursorStyle::Hand);
+	}
 
-				const bool finishedBySleep = (not c.body.isAwake());
-				const bool finishedByGoal = (c.timeSinceEnteredGoal && (*c.timeSinceEnteredGoal >= 1.0));
-				allFinished &= (finishedBySleep || finishedByGoal);
-			}
-			
-			// クエリが全てのボールを放出済みかチェック
-			bool hasFinishedReleasing = true;
-			if (stage.m_currentQueryIndex < stage.m_queries->size()) {
-				hasFinishedReleasing = (*stage.m_queries)[stage.m_currentQueryIndex]->hasFinishedReleasing();
-			}
-			
-			if (allFinished && hasFinishedReleasing) {
-				bool isSuccess = stage.checkSimulationResult();
-				int32 completedQueryIndex = stage.m_currentQueryIndex;
-				
-				// クリア演出用：今回初めてクリアしたかを判定
-				bool wasAlreadyCleared = stage.m_isCleared;
-				
-				if (isSuccess) {
-					bool preAllCompleted = stage.isAllQueriesCompleted();
-
-					// Console << U"Query {} Success!"_fmt(completedQueryIndex + 1);
-					stage.markQueryCompleted(completedQueryIndex);
-					
-					// 今回初めて全クエリクリアした場合のみ演出
-					if (stage.m_isCleared && !wasAlreadyCleared) {
-						// Console << U"★ Stage Cleared! ★";
-						startClearEffect();  // クリア演出を開始
-					}
+	// リプレイのシークバー（Instant モードは結果だけを出すモードなので、リプレイは等速で見せる）
+	// クエリパネルなどから実行が始まったらリプレイは終える
+	if (m_trajectoryPlayer.isActive()) {
+		if (stage.m_isSimulationRunning) {
+			m_trajectoryPlayer.stop();
+		}
+		else {
+			m_trajectoryPlayer.update(stage, m_cursorPos, dt, (isInstantMode() ? 1.0 : currentSimulationSpeed()));
+		}
+	}
 
-					if (not preAllCompleted && stage.isAllQueriesCompleted()) {
-						// TODO 
-						stage.save();
-#if SIV3D_PLATFORM(WEB)
-						Platform::Web::IndexedDB::SaveAsync();
-#endif // SIV3D_PLATFORM(WEB)
-						if (game.m_postTask.isEmpty() and (not game.m_username.contains(U"nosender")))
-						{
-							game.m_postTask = StageRecord(stage, game.m_username).createPostTask();
-						}
-					}
-				}
-				else {
-					// Console << U"Query {} Failed."_fmt(completedQueryIndex + 1);
-					stage.markQueryFailed(completedQueryIndex);
-				}
-				
-				stage.endSimulation();
+	// 並列検証の完了チェック
+	updateVerifyAll(game, stage);
+
+	// 終了判定（落下ボールの除去を含む）
+	// Instant モードでは実時間予算の範囲で判定が出るまで一気に進める
+	const bool isInstantStepping = isInstantMode();
+	const auto verdict = isInstantStepping
+		? SimulationEngine{ stage }.advanceWithinBudget(m_instantStepBudgetMs)
+		: SimulationEngine{ stage }.pollVerdict();
+	if (verdict) {
+		int32 completedQueryIndex = stage.m_currentQueryIndex;
+		applyQueryResult(game, stage, completedQueryIndex, *verdict);
+		
+		stage.endSimulation();
 
-				// 単独実行モードの場合は次に進まない
-				if (m_singleQueryMode) {
-					// Console << U"Single query test completed.";
-					m_singleQueryMode = false;
-				}
-				else {
-					// 次の未判定クエリを探す（成功・失敗に関わらず続行）
+		// 単独実行モードの場合は次に進まない
+		if (m_singleQueryMode) {
+			// Console << U"Single query test completed.";
+			m_singleQueryMode = false;
+		}
+		else {
+			// 次の未判定クエリを探す（成功・失敗に関わらず続行）
 
-					if (completedQueryIndex + 1 < stage.m_queries->size()) {
-						stage.m_currentQueryIndex = completedQueryIndex + 1;
-						stage.startSimulationWithSave();
-					}
-					else {
-						// 全クエリの判定が完了
-						// Console << U"All queries tested.";
-						stage.m_currentQueryIndex = 0;
-					}
-				}
+			if (completedQueryIndex + 1 < stage.m_queries->size()) {
+				stage.m_currentQueryIndex = completedQueryIndex + 1;
+				stage.startSimulationWithSave();
+			}
+			else {
+				// 全クエリの判定が完了
+				// Console << U"All queries tested.";
+				stage.m_currentQueryIndex = 0;
 			}
 		}
 	}
@@ -967,58 +946,11 @@ void StageUI::update(Game& game, Stage& stage, double dt)
 
 		// PrintDebug(Cursor::PosF());
 
-		if (stage.m_isSimulationRunning && !stage.m_isSimulationPaused) {
-			// 速度倍率を適用
-			for (stage.m_simulationTimeAccumlate += dt * stage.m_simulationSpeed; stage.m_simulationTimeAccumlate >= Stage::simulationTimeStep; stage.m_simulationTimeAccumlate -= Stage::simulationTimeStep) {
-				stage.m_world.update(Stage::simulationTimeStep);
-
-				// ゴール侵入判定：ゴールに入ってからの経過時間を更新
-				for (auto& b : stage.m_startBallsInWorld) {
-					if (b.body.isEmpty()) {
-						b.timeSinceEnteredGoal = none;
-						continue;
-					}
-
-					const Vec2 pos = b.body.getPos();
-					bool inGoal = false;
-					for (const auto& g : stage.m_goalAreas) {
-						if (g.rect.contains(pos)) {
-							inGoal = true;
-							break;
-						}
-					}
-
-					if (inGoal) {
-						if (b.timeSinceEnteredGoal) {
-							*b.timeSinceEnteredGoal += Stage::simulationTimeStep;
-						}
-						else {
-						 b.timeSinceEnteredGoal = 0.0;
-						}
-					}
-					else {
-						b.timeSinceEnteredGoal = none;
-					}
-				}
-
-				// クエリの時間ベース更新（SequentialQuery用）
-				if (stage.m_currentQueryIndex < stage.m_queries->size()) {
-					(*stage.m_queries)[stage.m_currentQueryIndex]->update(stage, Stage::simulationTimeStep);
-				}
-
-				// 遅すぎる場合は強制終了
-				for (auto& c : stage.m_startBallsInWorld) {
-					Vec2 vel = c.body.getVelocity();
-					double angleV = c.body.getAngularVelocity();
-					if (abs(vel.y) < 0.001 and abs(vel.x) < 2 and abs(angleV) < 0.1) {
-						c.body.setVelocity({ 0,0 });
-						c.body.setAngularVelocity(0);
-					}
-				}
-
-			}
+		if (not isInstantStepping) {
+			SimulationEngine{ stage }.advance(dt);
 		}
-		if (not stage.m_isSimulationRunning) {
+
+		if (not stage.m_isSimulationRunning and not m_trajectoryPlayer.isActive()) {
 			// コンテキストメニューを開くコールバック
 			auto openContextMenuCallback = [this](const Vec2& worldPos, bool alignRight) {
 				// ワールド座標をスクリーン座標に変換
@@ -1076,6 +1008,22 @@ void StageUI::update(Game& game, Stage& stage, double dt)
 
 #if SIV3D_BUILD(DEBUG)
 	PrintDebug(m_editUI.selectedIDs());
+	Print << U"Undo history: {} + {} entries, {} KB"_fmt(m_undoStack.size(), m_redoStack.size(), (m_undoHistoryBytes + 1023) / 1024);
+	{
+		// 差分更新しているスコアの集計が全走査と一致するか（長さは整数にしたスコアを送信する値とも比べる）
+		const auto& score = stage.scoreCounters();
+		const auto expected = stage.computeScoreCounters();
+		if (score.unlockedEdgeCount != expected.unlockedEdgeCount
+			|| score.unlockedPlacedBallCount != expected.unlockedPlacedBallCount
+			|| score.totalLengthUnits != expected.totalLengthUnits
+			|| score.totalLengthScore() != stage.CalculateTotalLength()) {
+			Print << U"Score counters mismatch: Obj {} / {}, Len {} / {}"_fmt(score.numberOfObjects(), expected.numberOfObjects(), score.totalLengthScore(), stage.CalculateTotalLength());
+		}
+	}
+	// 差分で数えている履歴のバイト数が全走査と一致するか
+	if (const size_t expectedBytes = calculateUndoHistoryBytes(); m_undoHistoryBytes != expectedBytes) {
+		Print << U"Undo history bytes mismatch: {} / {}"_fmt(m_undoHistoryBytes, expectedBytes);
+	}
 #endif
 
 
@@ -1104,8 +1052,20 @@ void StageUI::draw(const Stage& stage) const
 	{
 		auto cameraTf = m_camera.createTransformer();
 
-		// world draw (edit or simulation)
-		m_editUI.drawWorld(stage, m_camera);
+		// world draw (edit, simulation or replay)
+		if (m_trajectoryPlayer.isActive()) {
+			m_editUI.drawPlayback(stage, m_trajectoryPlayer.currentFrames(stage));
+		}
+		else {
+#if SIV3D_BUILD(DEBUG)
+			// 大きなグループを選択したときの描画コストの確認用
+			const Stopwatch drawWorldWatch{ StartImmediately::Yes };
+			m_editUI.drawWorld(stage, m_camera);
+			Print << U"drawWorld: {:.3f} ms (selected: {})"_fmt(drawWorldWatch.usF() / 1000.0, m_editUI.selectedIDs().size());
+#else
+			m_editUI.drawWorld(stage, m_camera);
+#endif
+		}
 
 		// Straight ステージ向けライン作成ガイド
 		if (stage.m_name == U"Straight" && !stage.m_isSimulationRunning and not stage.m_isCleared)
@@ -1168,6 +1128,14 @@ void StageUI::draw(const Stage& stage) const
 		RectF nameBg{ left, 23, w, 44 };
 		nameBg.rounded(8).draw(ColorF(0.0, 0.25));
 		font(stage.m_name).draw(20, Vec2{ nameBg.x + 12, nameBg.y + 10 }, ColorF(0.95));
+
+		// Instant モードの進捗（判定済みクエリ数とシミュレーション内の経過時間）
+		if (isInstantMode() && stage.m_isSimulationRunning && !stage.m_queries->empty()) {
+			const double progress = static_cast<double>(stage.m_currentQueryIndex) / stage.m_queries->size();
+			RectF{ nameBg.x + 6, nameBg.bottomY() - 6, (nameBg.w - 12) * progress, 3 }.draw(ColorF(0.3, 0.6, 0.8));
+			font(U"Query {}/{}  {:.1f}s"_fmt(stage.m_currentQueryIndex + 1, stage.m_queries->size(), stage.m_simulationStepCount * Stage::simulationTimeStep))
+				.draw(14, Arg::rightCenter = Vec2{ nameBg.rightX() - 12, nameBg.centerY() }, ColorF(0.8, 0.9, 1.0));
+		}
 	}
 
 	auto drawButton = [&](const RectF& rect, const String& text, const String& icon, ColorF baseColor, bool enabled, bool hovered, bool emphasized = false, int32 textSize = 13) {
@@ -1258,7 +1226,18 @@ void StageUI::draw(const Stage& stage) const
 	// Simulation buttons
 	bool simRunning = stage.m_isSimulationRunning;
 	bool startHovered = m_simulationStartButtonRect.mouseOver();
-	drawButton(m_simulationStartButtonRect, U"Run", U"\uF04B", ColorF(0.3, 0.7, 0.4), !simRunning, startHovered);
+	drawButton(m_simulationStartButtonRect, U"Run", U"\uF04B", ColorF(0.3, 0.7, 0.4), !simRunning && !isVerifyingAll(), startHovered);
+	if (isVerifyingAll()) {
+		// 並列検証中はスピナー表示
+		const double angle = Scene::Time() * 360.0;
+		const Vec2 c = m_simulationStartButtonRect.center();
+		const double r = 12.0;
+		for (int i = 0; i < 8; ++i) {
+			double a = ToRadians(angle + i * 45.0);
+			double alpha = (8 - i) / 8.0;
+			Circle{ c + Vec2{ Cos(a), Sin(a) } * r, 2.5 }.draw(ColorF(0.7, 1.0, 0.8, alpha));
+		}
+	}
 
 	bool pauseHovered = m_simulationPauseButtonRect.mouseOver();
 	String pauseText = stage.m_isSimulationPaused ? U"Resume" : U"Pause";
@@ -1267,12 +1246,22 @@ void StageUI::draw(const Stage& stage) const
 	drawButton(m_simulationPauseButtonRect, pauseText, pauseIcon, pauseColor, simRunning, pauseHovered);
 
 	bool stopHovered = m_simulationStopButtonRect.mouseOver();
-	drawButton(m_simulationStopButtonRect, U"Stop", U"\uF04D", ColorF(0.7, 0.3, 0.3), simRunning, stopHovered);
+	drawButton(m_simulationStopButtonRect, U"Stop", U"\uF04D", ColorF(0.7, 0.3, 0.3), simRunning || m_trajectoryPlayer.isActive(), stopHovered);
 
 	bool ffHovered = m_simulationFastForwardButtonRect.mouseOver();
-	String ffText = U"{}x"_fmt(static_cast<int>(kSimulationSpeeds[m_speedIndex]));
+	String ffText = isInstantMode() ? String{ U"Max" } : U"{}x"_fmt(static_cast<int>(kSimulationSpeeds[m_speedIndex]));
+	String ffIcon = isInstantMode() ? U"\uF0E7" : U"\uF04E";
 	ColorF ffColor = m_speedIndex != 0 ? ColorF(0.3, 0.6, 0.8) : ColorF(0.4, 0.5, 0.6);
-	drawButton(m_simulationFastForwardButtonRect, ffText, U"\uF04E", ffColor, true, ffHovered);
+	drawButton(m_simulationFastForwardButtonRect, ffText, ffIcon, ffColor, true, ffHovered);
+
+	// 記録した軌跡のリプレイ
+	if (m_trajectoryPlayer.isActive()) {
+		m_trajectoryPlayer.draw(stage);
+	}
+	else if (!simRunning && stage.hasTrajectoryRecording()) {
+		bool replayHovered = m_replayButtonRect.mouseOver();
+		drawButton(m_replayButtonRect, U"Replay", U"\uF1DA", ColorF(0.3, 0.55, 0.75), true, replayHovered);
+	}
 
 	// Leaderboard / Share icon buttons
 	{
@@ -1421,10 +1410,11 @@ void StageUI::draw(const Stage& stage) const
 		m_contextMenu.draw();
 	}
 
-	// Obj / Len 表示
-	if (!stage.m_isSimulationRunning and stage.m_isCleared) {
+	// Obj / Len 表示（差分更新している集計を読むだけなので、編集中も毎フレーム出す）
+	if (!stage.m_isSimulationRunning) {
 		const Font& font = FontAsset(U"Regular");
-		const String infoText = U"Obj: {}, Len: {}"_fmt(stage.CalculateNumberOfObjects(), stage.CalculateTotalLength());
+		const auto& score = stage.scoreCounters();
+		const String infoText = U"Obj: {}, Len: {}"_fmt(score.numberOfObjects(), score.totalLengthScore());
 		const Vec2 pos{ 20, 90 };
 		RectF bgRect = font(infoText).region(14, pos).stretched(8, 4);
 		bgRect.rounded(4).draw(ColorF(0.0, 0.25));
@@ -1435,16 +1425,105 @@ void StageUI::draw(const Stage& stage) const
 	drawClearEffect();
 }
 
+bool StageUI::isInstantMode() const
+{
+	return m_speedIndex >= kSimulationSpeeds.size();
+}
+
+double StageUI::currentSimulationSpeed() const
+{
+	return isInstantMode() ? kSimulationSpeeds.back() : kSimulationSpeeds[m_speedIndex];
+}
+
+void StageUI::applyQueryResult(Game& game, Stage& stage, int32 queryIndex, bool isSuccess)
+{
+	// クリア演出用：今回初めてクリアしたかを判定
+	bool wasAlreadyCleared = stage.m_isCleared;
+	
+	if (isSuccess) {
+		bool preAllCompleted = stage.isAllQueriesCompleted();
+
+		// Console << U"Query {} Success!"_fmt(queryIndex + 1);
+		stage.markQueryCompleted(queryIndex);
+		
+		// 今回初めて全クエリクリアした場合のみ演出
+		if (stage.m_isCleared && !wasAlreadyCleared) {
+			// Console << U"★ Stage Cleared! ★";
+			startClearEffect();  // クリア演出を開始
+		}
+
+		if (not preAllCompleted && stage.isAllQueriesCompleted()) {
+			// TODO 
+			stage.save();
+#if SIV3D_PLATFORM(WEB)
+			Platform::Web::IndexedDB::SaveAsync();
+#endif // SIV3D_PLATFORM(WEB)
+			if (game.m_postTask.isEmpty() and (not game.m_username.contains(U"nosender")))
+			{
+				game.m_postTask = StageRecord(stage, game.m_username).createPostTask();
+			}
+		}
+	}
+	else {
+		// Console << U"Query {} Failed."_fmt(queryIndex + 1);
+		stage.markQueryFailed(queryIndex);
+	}
+}
+
+void StageUI::updateVerifyAll(Game& game, Stage& stage)
+{
+	if (not m_verifyAllTask.isReady()) {
+		return;
+	}
+
+	const auto results = m_verifyAllTask.get();
+	if (m_verifyAllInvalidated) {
+		return;
+	}
+
+	for (const auto& result : results) {
+		applyQueryResult(game, stage, result.queryIndex, result.isSuccess);
+	}
+	stage.m_currentQueryIndex = 0;
+}
+
 void StageUI::pushUndoState(Stage& stage)
 {
-	StageSnapshot snapshot = stage.createSnapshot();
-	m_redoStack.clear();
-	m_undoStack.push_back(snapshot);
-	while (m_undoStack.size() > MAX_UNDO_HISTORY) {
+	// 直前の状態と同じ要素は共有するので、実際に複製されるのは今回の編集で変わった要素だけ
+	StageSnapshot snapshot = stage.createSnapshot(m_undoStack.isEmpty() ? nullptr : &m_undoStack.back());
+	while (not m_redoStack.empty()) {
+		m_undoHistoryBytes -= m_redoStack.back().exclusiveMemoryUsage();
+		m_redoStack.pop_back();
+	}
+	appendUndoSnapshot(std::move(snapshot));
+
+	// 予算を超えたら古いものから捨てる（Undo に必要な2件は残す）
+	while (m_undoHistoryBytes > MaxUndoHistoryBytes && m_undoStack.size() > 2) {
+		m_undoHistoryBytes -= m_undoStack.front().exclusiveMemoryUsage();
 		m_undoStack.pop_front();
 	}
 }
 
+void StageUI::appendUndoSnapshot(StageSnapshot snapshot)
+{
+	// 作ったばかりのスナップショットだけが持っている要素が、今回増えたぶん
+	m_undoHistoryBytes += snapshot.exclusiveMemoryUsage();
+	m_undoStack.push_back(std::move(snapshot));
+}
+
+size_t StageUI::calculateUndoHistoryBytes() const
+{
+	HashSet<const void*> counted;
+	size_t bytes = 0;
+	for (const auto& snapshot : m_undoStack) {
+		bytes += snapshot.memoryUsage(counted);
+	}
+	for (const auto& snapshot : m_redoStack) {
+		bytes += snapshot.memoryUsage(counted);
+	}
+	return bytes;
+}
+
 void StageUI::undo(Stage& stage)
 {
 	if (m_undoStack.size() < 2) return;
@@ -1452,6 +1531,9 @@ void StageUI::undo(Stage& stage)
 	m_undoStack.pop_back();
 	stage.restoreSnapshot(m_undoStack.back());
 	m_editUI.selectedIDs().clear();
+	m_verifyAllInvalidated = true;
+	m_trajectoryPlayer.stop();
+	stage.m_trajectoryRecordings.clear();
 	if (!stage.m_isCleared) {
 		stage.resetQueryProgress();
 	}
@@ -1465,6 +1547,9 @@ void StageUI::redo(Stage& stage)
 	stage.restoreSnapshot(snapshot);
 	m_undoStack.push_back(snapshot);
 	m_editUI.selectedIDs().clear();
+	m_verifyAllInvalidated = true;
+	m_trajectoryPlayer.stop();
+	stage.m_trajectoryRecordings.clear();
 	if (!stage.m_isCleared) {
 		stage.resetQueryProgress();
 	}
@@ -1474,6 +1559,7 @@ void StageUI::clearUndoRedoHistory()
 {
 	m_undoStack.clear();
 	m_redoStack.clear();
+	m_undoHistoryBytes = 0;
 }
 
 void StageUI::startClearEffect()
@@ -8,10 +8,12 @@
 # include "SimpleWatch.hpp"
 # include "Inventory.h"
 # include "Stage.hpp"
+# include "SimulationEngine.hpp"
 # include "ScrollBar.h"
 # include "MyCamera2D.h"
 # include "StageEditUI.h"
 # include "QueryPanel.h"
+# include "TrajectoryPlayer.h"
 # include "ContextMenu.h"
 # include "DPadUI.h"
 # include "DragModeToggle.h"
@@ -106,9 +108,11 @@ private:
 	double m_twoFingerBaseScale = 1.0;
 	double m_twoFingerBaseDistance = 1.0;
 
+	// 隣り合うスナップショットは変わっていない要素を共有するので、件数ではなく概算バイト数で上限を決める
 	Array<StageSnapshot> m_undoStack;
 	Array<StageSnapshot> m_redoStack;
-	static constexpr int32 MAX_UNDO_HISTORY = 50;
+	static constexpr size_t MaxUndoHistoryBytes = 16 * 1024 * 1024;
+	size_t m_undoHistoryBytes = 0;  // Undo/Redo 履歴全体の概算バイト数（共有ぶんは1回だけ数える。積む・捨てるたびに差分で更新する）
 	
 	// チュートリアルテキスト表示用
 	Array<String> m_tutorialTexts;
@@ -121,8 +125,26 @@ private:
 	enum class ShareStatus { Idle, Sending, Ready, Done } m_shareStatus = ShareStatus::Idle;
 	String m_shareURL;
 
-	// シミュレーション速度
+	// シミュレーション速度（kSimulationSpeeds の次のインデックスが Instant モード）
 	int32 m_speedIndex = 0;
+	bool isInstantMode() const;
+	double currentSimulationSpeed() const;
+
+	// Instant モード: 1フレームの実時間予算いっぱいまでステップを進めて判定を急ぐ
+	double m_instantStepBudgetMs = 10.0;
+
+	// 記録した軌跡のリプレイ（物理演算なしで再生・シークする）
+	TrajectoryPlayer m_trajectoryPlayer;
+	RectF m_replayButtonRect{ 0, 0, 0, 0 };
+
+	// 全クエリ並列検証（Shift + Run）
+	AsyncTask<Array<SimulationEngine::QueryResult>> m_verifyAllTask;
+	bool m_verifyAllInvalidated = false;  // 検証中に編集・ステージ切り替えがあったら結果を捨てる
+	bool isVerifyingAll() const { return m_verifyAllTask.isValid(); }
+	void updateVerifyAll(Game& game, Stage& stage);
+
+	// クエリ1件の判定結果を反映（初回クリア時の演出・保存・記録送信を含む）
+	void applyQueryResult(Game& game, Stage& stage, int32 queryIndex, bool isSuccess);
 
 	// クリア演出用
 	bool m_showClearEffect = false;
@@ -134,14 +156,16 @@ private:
 	void updateClearEffect(double dt);
 	void drawClearEffect() const;
 
-	bool hasSameObjectWithClipboard(const Stage& stage) const;
+	bool hasSameObjectWithClipboard(const Stage& stage, const Vec2& offset) const;
 	void eraseSelection(Stage& stage);
 	void onStageEdited(Stage& stage);
 
 	void pasteFromClipboard(Stage& stage);
 
 	void pushUndoState(Stage& stage);
+	void appendUndoSnapshot(StageSnapshot snapshot);
 	void undo(Stage& stage);
 	void redo(Stage& stage);
 	void clearUndoRedoHistory();
+	size_t calculateUndoHistoryBytes() const;  // 全走査（m_undoHistoryBytes の照合用）
 };
@@ -0,0 +1,280 @@
+﻿# include "StaticLayerCache.hpp"
+# include "Stage.hpp"
+
+namespace
+{
+	// Buffer2D の添字は 16bit なので、1つのメッシュに入れる頂点数はこれ以下に抑える
+	constexpr size_t MaxVerticesPerMesh = 60000;
+
+	// 描画関数（Line::draw, RectF::drawFrame など）と同じ形の三角形を積んでいく
+	class MeshBuilder {
+	public:
+		explicit MeshBuilder(double circleQuality)
+			: m_circleQuality(circleQuality) {}
+
+		// Line::draw と同じく両端を太さの半分だけ延ばした四角形
+		void line(const Vec2& begin, const Vec2& end, double thickness, const ColorF& color)
+		{
+			const Vec2 v = end - begin;
+			if (v.isZero()) {
+				return;
+			}
+			const Vec2 dir = v.normalized() * (thickness * 0.5);
+			const Vec2 normal{ -dir.y, dir.x };
+			const Vec2 b = begin - dir;
+			const Vec2 e = end + dir;
+			quad(b + normal, e + normal, e - normal, b - normal, color);
+		}
+
+		void rect(const RectF& r, const ColorF& color)
+		{
+			quad(r.tl(), r.tr(), r.br(), r.bl(), color);
+		}
+
+		// RectF::drawFrame と同じく辺の内外に太さの半分ずつ
+		void rectFrame(const RectF& r, double thickness, const ColorF& color)
+		{
+			const RectF outer = r.stretched(thickness * 0.5);
+			const RectF inner = r.stretched(-thickness * 0.5);
+			ring({ outer.tl(), outer.tr(), outer.br(), outer.bl() }, { inner.tl(), inner.tr(), inner.br(), inner.bl() }, color);
+		}
+
+		void circle(const Circle& c, const ColorF& color)
+		{
+			const int32 n = segments(c.r);
+			const auto base = static_cast<Vertex2D::IndexType>(m_vertices.size());
+			push(c.center, color);
+			for (int32 k = 0; k < n; ++k) {
+				push(c.center + Circular(c.r, Math::TwoPi * k / n).toVec2(), color);
+			}
+			for (int32 k = 0; k < n; ++k) {
+				m_indices.push_back({ base, static_cast<Vertex2D::IndexType>(base + 1 + k), static_cast<Vertex2D::IndexType>(base + 1 + (k + 1) % n) });
+			}
+		}
+
+		void circleFrame(const Circle& c, double thickness, const ColorF& color)
+		{
+			const int32 n = segments(c.r + thickness * 0.5);
+			Array<Vec2> outer(n), inner(n);
+			for (int32 k = 0; k < n; ++k) {
+				outer[k] = c.center + Circular(c.r + thickness * 0.5, Math::TwoPi * k / n).toVec2();
+				inner[k] = c.center + Circular(Max(c.r - thickness * 0.5, 0.0), Math::TwoPi * k / n).toVec2();
+			}
+			ring(outer, inner, color);
+		}
+
+		// ここまでの三角形を1つのメッシュにして返す（空なら none）
+		Optional<Buffer2D> flush()
+		{
+			if (m_vertices.isEmpty()) {
+				return none;
+			}
+			Buffer2D mesh{ std::move(m_vertices), std::move(m_indices) };
+			m_vertices.clear();
+			m_indices.clear();
+			return mesh;
+		}
+
+		// あと additional 個の頂点を足すと添字が足りなくなるか
+		bool isFull(size_t additional) const { return MaxVerticesPerMesh < m_vertices.size() + additional; }
+
+	private:
+		double m_circleQuality;  // 円周 1 あたりの分割数
+		Array<Vertex2D> m_vertices;
+		Array<TriangleIndex> m_indices;
+
+		int32 segments(double r) const
+		{
+			return Clamp(static_cast<int32>(Math::Ceil(r * m_circleQuality)), 12, 256);
+		}
+
+		void push(const Vec2& pos, const ColorF& color)
+		{
+			Vertex2D v;
+			v.pos = pos;
+			v.tex = Float2{ 0, 0 };
+			v.color = color.toFloat4();
+			m_vertices.push_back(v);
+		}
+
+		void quad(const Vec2& p0, const Vec2& p1, const Vec2& p2, const Vec2& p3, const ColorF& color)
+		{
+			const auto base = static_cast<Vertex2D::IndexType>(m_vertices.size());
+			push(p0, color);
+			push(p1, color);
+			push(p2, color);
+			push(p3, color);
+			m_indices.push_back({ base, static_cast<Vertex2D::IndexType>(base + 1), static_cast<Vertex2D::IndexType>(base + 2) });
+			m_indices.push_back({ base, static_cast<Vertex2D::IndexType>(base + 2), static_cast<Vertex2D::IndexType>(base + 3) });
+		}
+
+		// outer と inner（同じ個数、同じ向き）の間を埋める帯
+		void ring(const Array<Vec2>& outer, const Array<Vec2>& inner, const ColorF& color)
+		{
+			const auto n = static_cast<Vertex2D::IndexType>(outer.size());
+			const auto base = static_cast<Vertex2D::IndexType>(m_vertices.size());
+			for (const auto& p : outer) push(p, color);
+			for (const auto& p : inner) push(p, color);
+			for (Vertex2D::IndexType k = 0; k < n; ++k) {
+				const auto next = static_cast<Vertex2D::IndexType>((k + 1) % n);
+				m_indices.push_back({ static_cast<Vertex2D::IndexType>(base + k), static_cast<Vertex2D::IndexType>(base + next), static_cast<Vertex2D::IndexType>(base + n + next) });
+				m_indices.push_back({ static_cast<Vertex2D::IndexType>(base + k), static_cast<Vertex2D::IndexType>(base + n + next), static_cast<Vertex2D::IndexType>(base + n + k) });
+			}
+		}
+	};
+}
+
+size_t StaticLayerCache::draw(const Stage& stage, double scale) const
+{
+	// 編集世代が変わったら、先頭の範囲と中身が本当に変わったかを照合する
+	// （ロックされていないオブジェクトの編集では先頭は変わらないので、作り直さずに済む）
+	if (m_stage != &stage || m_editGeneration != stage.editGeneration()) {
+		m_stage = &stage;
+		m_editGeneration = stage.editGeneration();
+
+		const size_t prefixLength = StaticPrefixLength(stage);
+		const uint64 fingerprint = Fingerprint(stage, prefixLength);
+		if (prefixLength != m_prefixLength || fingerprint != m_fingerprint) {
+			m_prefixLength = prefixLength;
+			m_fingerprint = fingerprint;
+			m_zoomBand.reset();
+		}
+	}
+
+	const int32 zoomBand = static_cast<int32>(Math::Round(Math::Log2(scale) * ZoomBandsPerOctave));
+	if (m_zoomBand != zoomBand) {
+		rebuild(stage, zoomBand);
+	}
+
+	for (const auto& chunk : m_chunks) {
+		if (chunk.mesh) {
+			chunk.mesh->draw();
+		}
+		if (chunk.label) {
+			FontAsset(U"Regular")(chunk.label->text).drawAt(14.0 / scale, chunk.label->center, ColorF(1.0));
+		}
+	}
+	return m_prefixLength;
+}
+
+size_t StaticLayerCache::StaticPrefixLength(const Stage& stage)
+{
+	// ロックされていないエッジと端点を共有するエッジは、点の選択・ホバーで強調されることがあるので含めない
+	auto isStaticPoint = [&](int32 pointId) {
+		for (int32 edgeIndex : stage.incidentEdges(pointId)) {
+			if (not stage.m_edges[edgeIndex].isLocked) return false;
+		}
+		return true;
+	};
+
+	size_t length = 0;
+	for (const auto& obj : stage.m_layerOrder) {
+		bool isStatic = false;
+		switch (obj.type) {
+		case LayerObjectType::Edge: {
+			const auto& edge = stage.m_edges[obj.id];
+			isStatic = edge.isLocked && isStaticPoint(edge[0]) && isStaticPoint(edge[1]);
+			break;
+		}
+		case LayerObjectType::GoalArea:
+			isStatic = stage.m_goalAreas[obj.id].isLocked;
+			break;
+		case LayerObjectType::StartCircle:
+			isStatic = stage.m_startCircles[obj.id].isLocked;
+			break;
+		case LayerObjectType::PlacedBall:
+			// シミュレーション中は描かないので、編集中と描き方が揃わない
+			break;
+		}
+		if (not isStatic) break;
+		++length;
+	}
+	return length;
+}
+
+uint64 StaticLayerCache::Fingerprint(const Stage& stage, size_t prefixLength)
+{
+	size_t seed = prefixLength;
+	for (size_t i = 0; i < prefixLength; ++i) {
+		const auto& obj = stage.m_layerOrder[i];
+		Hash::Combine(seed, obj.type);
+		Hash::Combine(seed, obj.id);
+		switch (obj.type) {
+		case LayerObjectType::Edge: {
+			const auto& edge = stage.m_edges[obj.id];
+			const Vec2& p1 = stage.m_points.at(edge[0]);
+			const Vec2& p2 = stage.m_points.at(edge[1]);
+			Hash::Combine(seed, hash_values(p1.x, p1.y, p2.x, p2.y));
+			break;
+		}
+		case LayerObjectType::GoalArea: {
+			const auto& r = stage.m_goalAreas[obj.id].rect;
+			Hash::Combine(seed, hash_values(r.x, r.y, r.w, r.h));
+			break;
+		}
+		case LayerObjectType::StartCircle: {
+			const auto& c = stage.m_startCircles[obj.id].circle;
+			Hash::Combine(seed, hash_values(c.x, c.y, c.r));
+			break;
+		}
+		case LayerObjectType::PlacedBall:
+			break;
+		}
+	}
+	return seed;
+}
+
+void StaticLayerCache::rebuild(const Stage& stage, int32 zoomBand) const
+{
+	m_zoomBand = zoomBand;
+	m_chunks.clear();
+
+	// 段階の代表の拡大率で太さと円の分割数を決める（画面上で約 6px ごとに1辺）
+	const double scale = Math::Exp2(zoomBand / ZoomBandsPerOctave);
+	MeshBuilder builder{ Math::TwoPi * scale / 6.0 };
+
+	auto flushMesh = [&]() {
+		if (auto mesh = builder.flush()) {
+			m_chunks.push_back(Chunk{ std::move(mesh), none });
+		}
+	};
+	// ラベルは後ろのオブジェクトより奥になるよう、ここまでのメッシュを描いた直後に描く
+	auto pushLabel = [&](const String& text, const Vec2& center) {
+		m_chunks.push_back(Chunk{ builder.flush(), Label{ text, center } });
+	};
+
+	// 色と太さは StageEditUI::drawSimulationScene と同じ
+	for (size_t i = 0; i < m_prefixLength; ++i) {
+		const auto& obj = stage.m_layerOrder[i];
+		switch (obj.type) {
+		case LayerObjectType::GoalArea: {
+			if (builder.isFull(8)) flushMesh();
+			const auto& r = stage.m_goalAreas[obj.id];
+			builder.rect(r.rect, ColorF(0.2, 0.65, 0.3, 0.5));
+			builder.rectFrame(r.rect, 2.0 / scale, ColorF(0.3, 0.75, 0.4, 0.7));
+			pushLabel(U"{}"_fmt(static_cast<char32>(U'A' + obj.id)), r.rect.center());
+			break;
+		}
+		case LayerObjectType::StartCircle: {
+			if (builder.isFull(256 * 3 + 1)) flushMesh();
+			const auto& c = stage.m_startCircles[obj.id];
+			builder.circle(c.circle, ColorF(0.2, 0.65, 0.3, 0.5));
+			builder.circleFrame(c.circle, 2.0 / scale, ColorF(0.3, 0.75, 0.4, 0.7));
+			pushLabel(U"{}"_fmt(static_cast<char32>(U'a' + obj.id)), c.circle.center);
+			break;
+		}
+		case LayerObjectType::Edge: {
+			if (builder.isFull(8)) flushMesh();
+			const auto& edge = stage.m_edges[obj.id];
+			const Vec2& p1 = stage.m_points.at(edge[0]);
+			const Vec2& p2 = stage.m_points.at(edge[1]);
+			builder.line(p1 + Vec2{ 2, 2 }, p2 + Vec2{ 2, 2 }, 3.0 / scale, ColorF(0.0, 0.2));
+			builder.line(p1, p2, 2.5 / scale, ColorF(0.6, 0.65, 0.7) * 0.6);
+			break;
+		}
+		case LayerObjectType::PlacedBall:
+			break;
+		}
+	}
+	flushMesh();
+}
@@ -0,0 +1,44 @@
+﻿#pragma once
+
+# include <Siv3D.hpp>
+
+class Stage;
+
+// 描画順の先頭に並んだ、ロックされて動かないオブジェクト（エッジ・GoalArea・StartCircle）の描画
+// 頂点をまとめて作っておき、ラベルの間ごとに1回の描画で済ませる
+// ステージの編集世代が変わったら先頭の範囲と中身を照合し、変わっていたときだけ作り直す
+// 線の太さは画面上で一定なので、ズームの段階が変わったときも作り直す
+class StaticLayerCache {
+public:
+	// scale: ワールド → 画面の拡大率
+	// キャッシュから描いた m_layerOrder の先頭の個数を返す（残りは呼び出し側で描く）
+	size_t draw(const Stage& stage, double scale) const;
+
+private:
+	static constexpr double ZoomBandsPerOctave = 16.0;  // ズームを何段階で区切るか（2倍ごとに。1段階の太さの差は約4%）
+
+	struct Label {
+		String text;
+		Vec2 center;
+	};
+
+	// 描画順に並べた塊（メッシュを描いてからラベルを描く）
+	struct Chunk {
+		Optional<Buffer2D> mesh;
+		Optional<Label> label;
+	};
+
+	mutable Array<Chunk> m_chunks;
+	mutable const Stage* m_stage = nullptr;
+	mutable uint64 m_editGeneration = 0;
+	mutable size_t m_prefixLength = 0;
+	mutable uint64 m_fingerprint = 0;
+	mutable Optional<int32> m_zoomBand;
+
+	// 先頭から続く、ロックされていて選択・ホバーされ得ないオブジェクトの数
+	static size_t StaticPrefixLength(const Stage& stage);
+	// 先頭 prefixLength 個の並びと形から作る照合用の値
+	static uint64 Fingerprint(const Stage& stage, size_t prefixLength);
+
+	void rebuild(const Stage& stage, int32 zoomBand) const;
+};
@@ -0,0 +1,164 @@
+﻿# include "TrajectoryPlayer.h"
+# include "Stage.hpp"
+
+bool TrajectoryPlayer::start(const Stage& stage)
+{
+	m_queryIndex = findRecordedQuery(stage, 0);
+	m_isPaused = false;
+	m_isScrubbing = false;
+	if (const auto* recording = currentRecording(stage)) {
+		m_step = recording->firstStep();
+		return true;
+	}
+	return false;
+}
+
+void TrajectoryPlayer::stop()
+{
+	m_queryIndex.reset();
+	m_isScrubbing = false;
+}
+
+void TrajectoryPlayer::update(const Stage& stage, SingleUseCursorPos& cursorPos, double dt, double speed)
+{
+	const auto* recording = currentRecording(stage);
+	if (not recording) {
+		stop();
+		return;
+	}
+
+	// 再生 / 一時停止
+	if (cursorPos.intersects_use(playButtonRect())) {
+		if (MouseL.down()) {
+			// 末尾で止まっていたら先頭のクエリから再生し直す
+			if (m_isPaused && not findRecordedQuery(stage, *m_queryIndex + 1) && m_step >= recording->endStep() - 1) {
+				start(stage);
+				return;
+			}
+			m_isPaused = !m_isPaused;
+		}
+		Cursor::RequestStyle(CursorStyle::Hand);
+	}
+
+	// シーク（ドラッグ中はバーの外に出ても追従する）
+	if (m_isScrubbing) {
+		if (MouseL.pressed()) {
+			seek(*recording, Cursor::PosF().x);
+			cursorPos.reset();
+		}
+		else {
+			m_isScrubbing = false;
+		}
+	}
+	else if (cursorPos.intersects_use(trackRect().stretched(0, 8))) {
+		if (MouseL.down()) {
+			m_isScrubbing = true;
+			seek(*recording, Cursor::PosF().x);
+		}
+		Cursor::RequestStyle(CursorStyle::Hand);
+	}
+
+	// バー上の操作を下のワールドに通さない
+	cursorPos.intersects_use(m_rect);
+
+	if (m_isPaused || m_isScrubbing) {
+		return;
+	}
+
+	m_step += dt * speed / Stage::simulationTimeStep;
+	if (m_step >= recording->endStep() - 1) {
+		// 次の記録済みクエリへ。最後なら末尾で止める
+		if (const auto next = findRecordedQuery(stage, *m_queryIndex + 1)) {
+			m_queryIndex = next;
+			m_step = currentRecording(stage)->firstStep();
+		}
+		else {
+			m_step = recording->endStep() - 1;
+			m_isPaused = true;
+		}
+	}
+}
+
+Array<TrajectoryRecording::BallFrame> TrajectoryPlayer::currentFrames(const Stage& stage) const
+{
+	if (const auto* recording = currentRecording(stage)) {
+		return recording->framesAt(static_cast<int32>(m_step));
+	}
+	return {};
+}
+
+void TrajectoryPlayer::draw(const Stage& stage) const
+{
+	const auto* recording = currentRecording(stage);
+	if (not recording) {
+		return;
+	}
+
+	m_rect.movedBy(2, 2).rounded(8).draw(ColorF(0.0, 0.3));
+	m_rect.rounded(8).draw(ColorF(0.1, 0.12, 0.16, 0.92));
+	m_rect.rounded(8).drawFrame(1, ColorF(1.0, 0.1));
+
+	// 再生 / 一時停止ボタン
+	const RectF playRect = playButtonRect();
+	const ColorF playColor = playRect.mouseOver() ? ColorF(0.4, 0.65, 0.85) : ColorF(0.3, 0.55, 0.75);
+	playRect.rounded(6).draw(playColor);
+	FontAsset(U"Icon")(m_isPaused ? U"\uF04B" : U"\uF04C").drawAt(14, playRect.center(), ColorF(1.0));
+
+	// シークバー
+	const RectF track = trackRect();
+	const int32 first = recording->firstStep();
+	const int32 last = recording->endStep() - 1;
+	const double t = (last > first) ? Clamp((m_step - first) / (last - first), 0.0, 1.0) : 1.0;
+	track.rounded(track.h / 2).draw(ColorF(1.0, 0.15));
+	RectF{ track.pos, track.w * t, track.h }.rounded(track.h / 2).draw(ColorF(0.3, 0.6, 0.8));
+	Circle{ track.x + track.w * t, track.centerY(), m_isScrubbing ? 8 : 6 }.draw(ColorF(0.9, 0.95, 1.0));
+
+	// クエリ番号・時刻・記録のメモリ使用量
+	const Font& font = FontAsset(U"Regular");
+	const String label = U"Query {}/{}  {:.1f}s / {:.1f}s  {} KB"_fmt(
+		*m_queryIndex + 1, stage.m_queries->size(),
+		m_step * Stage::simulationTimeStep, last * Stage::simulationTimeStep,
+		(stage.trajectoryMemoryUsage() + 1023) / 1024);
+	font(label).draw(12, Arg::rightCenter = Vec2{ m_rect.rightX() - 10, m_rect.centerY() }, ColorF(0.8, 0.9, 1.0));
+}
+
+RectF TrajectoryPlayer::playButtonRect() const
+{
+	return RectF{ m_rect.x + 6, m_rect.y + 6, m_rect.h - 12, m_rect.h - 12 };
+}
+
+RectF TrajectoryPlayer::trackRect() const
+{
+	// 右側はラベル用に空けておく
+	const double left = playButtonRect().rightX() + 14;
+	const double right = m_rect.rightX() - 220;
+	return RectF{ left, m_rect.centerY() - 3, Max(0.0, right - left), 6 };
+}
+
+const TrajectoryRecording* TrajectoryPlayer::currentRecording(const Stage& stage) const
+{
+	if (not m_queryIndex || *m_queryIndex >= stage.m_trajectoryRecordings.size()) {
+		return nullptr;
+	}
+	const auto& recording = stage.m_trajectoryRecordings[*m_queryIndex];
+	return recording.isEmpty() ? nullptr : &recording;
+}
+
+Optional<int32> TrajectoryPlayer::findRecordedQuery(const Stage& stage, int32 from) const
+{
+	for (int32 i = from; i < stage.m_trajectoryRecordings.size(); ++i) {
+		if (not stage.m_trajectoryRecordings[i].isEmpty()) {
+			return i;
+		}
+	}
+	return none;
+}
+
+void TrajectoryPlayer::seek(const TrajectoryRecording& recording, double cursorX)
+{
+	const RectF track = trackRect();
+	const double t = (track.w > 0) ? Clamp((cursorX - track.x) / track.w, 0.0, 1.0) : 0.0;
+	const int32 first = recording.firstStep();
+	const int32 last = recording.endStep() - 1;
+	m_step = first + t * (last - first);
+}
@@ -0,0 +1,49 @@
+﻿#pragma once
+
+# include <Siv3D.hpp>
+# include "InputUtils.hpp"
+# include "TrajectoryRecording.hpp"
+
+class Stage;
+
+// 記録済み軌跡の再生（物理演算は行わない）
+// シークバーのドラッグで任意の時点へ移動でき、再生速度は呼び出し側から渡す
+class TrajectoryPlayer {
+public:
+	TrajectoryPlayer() = default;
+
+	void setRect(const RectF& rect) { m_rect = rect; }
+	const RectF& rect() const { return m_rect; }
+
+	// 記録のある最初のクエリから再生を始める。記録が無ければ false
+	bool start(const Stage& stage);
+	void stop();
+	bool isActive() const { return m_queryIndex.has_value(); }
+
+	// 再生中のクエリ
+	Optional<int32> queryIndex() const { return m_queryIndex; }
+
+	// シークバーの操作と再生位置の更新（speed: 再生速度倍率）
+	void update(const Stage& stage, SingleUseCursorPos& cursorPos, double dt, double speed);
+
+	// 現在の再生位置のボール
+	Array<TrajectoryRecording::BallFrame> currentFrames(const Stage& stage) const;
+
+	// シークバーの描画（スクリーン座標）
+	void draw(const Stage& stage) const;
+
+private:
+	RectF m_rect{ 0, 0, 0, 0 };
+
+	Optional<int32> m_queryIndex;
+	double m_step = 0.0;
+	bool m_isPaused = false;
+	bool m_isScrubbing = false;
+
+	RectF playButtonRect() const;
+	RectF trackRect() const;
+
+	const TrajectoryRecording* currentRecording(const Stage& stage) const;
+	Optional<int32> findRecordedQuery(const Stage& stage, int32 from) const;
+	void seek(const TrajectoryRecording& recording, double cursorX);
+};
@@ -0,0 +1,159 @@
+﻿# include "TrajectoryRecording.hpp"
+# include "Stage.hpp"
+
+namespace {
+	Point QuantizePos(const Vec2& pos)
+	{
+		return Point{
+			static_cast<int32>(Math::Round(pos.x * TrajectoryRecording::PositionScale)),
+			static_cast<int32>(Math::Round(pos.y * TrajectoryRecording::PositionScale))
+		};
+	}
+
+	uint16 QuantizeAngle(double angle)
+	{
+		return static_cast<uint16>(static_cast<int64>(Math::Round(angle * TrajectoryRecording::AngleScale)) & 0xFFFF);
+	}
+
+	int16 ClampDelta(int32 d)
+	{
+		return static_cast<int16>(Clamp<int32>(d, std::numeric_limits<int16>::min(), std::numeric_limits<int16>::max()));
+	}
+}
+
+TrajectoryRecording::TrajectoryRecording(double maxSeconds)
+	: m_maxSteps(Max(1, static_cast<int32>(maxSeconds / Stage::simulationTimeStep)))
+{
+}
+
+void TrajectoryRecording::record(const Array<Ball>& balls)
+{
+	const int32 step = m_stepCount++;
+
+	// 前のステップの表を使い回す（clear() はバケットを残すので、毎ステップ確保し直さない）
+	HashTable<P2BodyID, size_t>& stillActive = m_nextActiveTracks;
+	stillActive.clear();
+	size_t continuedCount = 0;
+	for (const auto& ball : balls) {
+		if (ball.body.isEmpty()) continue;
+
+		const Point pos = QuantizePos(ball.body.getPos());
+		const uint16 angle = QuantizeAngle(ball.body.getAngle());
+
+		auto it = m_activeTracks.find(ball.body.id());
+		if (it == m_activeTracks.end()) {
+			// 新しく放出されたボール
+			Track track;
+			track.kind = ball.kind;
+			track.baseStep = step;
+			track.basePos = track.lastPos = pos;
+			track.baseAngle = track.lastAngle = angle;
+			m_tracks.push_back(std::move(track));
+			stillActive.emplace(ball.body.id(), m_tracks.size() - 1);
+			continue;
+		}
+
+		Track& track = m_tracks[it->second];
+		Delta delta{
+			ClampDelta(pos.x - track.lastPos.x),
+			ClampDelta(pos.y - track.lastPos.y),
+			static_cast<uint16>(angle - track.lastAngle)
+		};
+		// 差分が int16 に収まらないほど飛んだ場合も、復元側と同じ値を積み上げてずれを残さない
+		track.lastPos += Point{ delta.dx, delta.dy };
+		track.lastAngle = angle;
+
+		if (track.ring.size() < static_cast<size_t>(m_maxSteps)) {
+			track.ring.push_back(delta);
+		}
+		else {
+			// 最古の差分を基準状態に畳み込んで上書き
+			const Delta& oldest = track.ring[track.head];
+			track.basePos += Point{ oldest.dx, oldest.dy };
+			track.baseAngle = static_cast<uint16>(track.baseAngle + oldest.dAngle);
+			++track.baseStep;
+			track.ring[track.head] = delta;
+			track.head = (track.head + 1) % track.ring.size();
+		}
+		stillActive.emplace(it->first, it->second);
+		++continuedCount;
+	}
+
+	const bool hasEnded = (continuedCount < m_activeTracks.size());
+	std::swap(m_activeTracks, m_nextActiveTracks);
+
+	if (hasEnded || (step % 60 == 0)) {
+		pruneEndedTracks();
+	}
+}
+
+void TrajectoryRecording::pruneEndedTracks()
+{
+	// 消えたボールのうち、再生可能範囲より前に終わったものを捨てる
+	const int32 first = firstStep();
+	HashSet<size_t> activeIndices;
+	for (const auto& [id, index] : m_activeTracks) {
+		activeIndices.insert(index);
+	}
+
+	Array<Track> kept;
+	HashTable<size_t, size_t> remap;
+	for (size_t i = 0; i < m_tracks.size(); ++i) {
+		if (activeIndices.contains(i) || m_tracks[i].lastStep() >= first) {
+			remap.emplace(i, kept.size());
+			kept.push_back(std::move(m_tracks[i]));
+		}
+	}
+	if (kept.size() == m_tracks.size()) {
+		m_tracks = std::move(kept);
+		return;
+	}
+
+	m_tracks = std::move(kept);
+	for (auto& [id, index] : m_activeTracks) {
+		index = remap.at(index);
+	}
+}
+
+Array<TrajectoryRecording::BallFrame> TrajectoryRecording::framesAt(int32 step) const
+{
+	Array<BallFrame> frames;
+	if (isEmpty()) {
+		return frames;
+	}
+	step = Clamp(step, firstStep(), endStep() - 1);
+
+	for (const auto& track : m_tracks) {
+		if (step < track.baseStep || track.lastStep() < step) continue;
+
+		// 直前の復元位置から進められるならそこから、そうでなければ基準状態から差分を適用する
+		if (track.cursorStep < track.baseStep || step < track.cursorStep) {
+			track.cursorStep = track.baseStep;
+			track.cursorPos = track.basePos;
+			track.cursorAngle = track.baseAngle;
+		}
+		for (int32 s = track.cursorStep; s < step; ++s) {
+			const Delta& delta = track.ring[(track.head + (s - track.baseStep)) % track.ring.size()];
+			track.cursorPos += Point{ delta.dx, delta.dy };
+			track.cursorAngle = static_cast<uint16>(track.cursorAngle + delta.dAngle);
+		}
+		track.cursorStep = step;
+
+		frames.push_back(BallFrame{
+			Vec2{ track.cursorPos.x / PositionScale, track.cursorPos.y / PositionScale },
+			track.cursorAngle / AngleScale,
+			track.kind
+		});
+	}
+	return frames;
+}
+
+size_t TrajectoryRecording::memoryUsage() const
+{
+	size_t bytes = sizeof(*this) + m_tracks.capacity() * sizeof(Track);
+	for (const auto& track : m_tracks) {
+		bytes += track.ring.capacity() * sizeof(Delta);
+	}
+	bytes += m_activeTracks.size() * (sizeof(P2BodyID) + sizeof(size_t));
+	return bytes;
+}
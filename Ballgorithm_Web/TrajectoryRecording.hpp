@@ -0,0 +1,79 @@
+﻿#pragma once
+
+# include <Siv3D.hpp>
+# include "Query.hpp"
+
+// 1クエリぶんのボール軌跡の記録（物理演算なしで再生するため）
+// 位置・角度を量子化し、ボールごとにステップ間の差分をリングバッファに持つ
+// 上限を超えた古い差分は基準状態に畳み込むので、直近 maxSeconds 秒だけが再生可能
+class TrajectoryRecording {
+public:
+	// 量子化の単位（位置は 1/16 px、角度は 1周を 65536 分割）
+	static constexpr double PositionScale = 16.0;
+	static constexpr double AngleScale = 65536.0 / Math::TwoPi;
+
+	// 再生用に復元したボールの状態
+	struct BallFrame {
+		Vec2 pos;
+		double angle = 0.0;
+		BallKind kind = BallKind::Small;
+	};
+
+	TrajectoryRecording() = default;
+	explicit TrajectoryRecording(double maxSeconds);
+
+	// 現在のボールの状態を1ステップぶん記録する（開始時に1回、以降は固定ステップごとに呼ぶ）
+	void record(const Array<Ball>& balls);
+
+	// 再生可能なステップ範囲 [firstStep(), endStep())
+	int32 firstStep() const { return Max(0, m_stepCount - 1 - m_maxSteps); }
+	int32 endStep() const { return m_stepCount; }
+	bool isEmpty() const { return m_stepCount == 0; }
+
+	// 指定ステップ時点のボールを復元する（範囲外のステップは端に丸める）
+	// 直前に復元したステップから順方向に進める場合は差分だけを適用する
+	Array<BallFrame> framesAt(int32 step) const;
+
+	// 記録に使っているおおよそのメモリ量（バイト）
+	size_t memoryUsage() const;
+
+private:
+	// 1ステップぶんの差分（1ボールあたり 6 バイト）
+	struct Delta {
+		int16 dx = 0;
+		int16 dy = 0;
+		uint16 dAngle = 0;
+	};
+
+	struct Track {
+		BallKind kind = BallKind::Small;
+
+		// ring の最古の差分を適用する直前の状態
+		int32 baseStep = 0;
+		Point basePos{ 0, 0 };
+		uint16 baseAngle = 0;
+
+		// 最後に記録した状態（次の差分の計算用）
+		Point lastPos{ 0, 0 };
+		uint16 lastAngle = 0;
+
+		// baseStep 以降の差分。容量に達したら head から上書きする
+		Array<Delta> ring;
+		size_t head = 0;
+
+		// 再生用の復元位置キャッシュ
+		mutable int32 cursorStep = -1;
+		mutable Point cursorPos{ 0, 0 };
+		mutable uint16 cursorAngle = 0;
+
+		int32 lastStep() const { return baseStep + static_cast<int32>(ring.size()); }
+	};
+
+	int32 m_maxSteps = 0;
+	int32 m_stepCount = 0;
+	Array<Track> m_tracks;
+	HashTable<P2BodyID, size_t> m_activeTracks;  // 記録中のボール → m_tracks のインデックス
+	HashTable<P2BodyID, size_t> m_nextActiveTracks;  // record() の作業用（次のステップの m_activeTracks を作り、入れ替える）
+
+	void pruneEndedTracks();
+};